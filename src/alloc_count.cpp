@@ -0,0 +1,115 @@
+#include "alloc_count.h"
+
+#include <SDL2/SDL.h>
+
+#include <cstdlib>
+#include <new>
+
+#if __cplusplus >= 201103L
+#define NEW_THROWS
+#define NEW_NOTHROW noexcept
+#else
+#define NEW_THROWS throw(std::bad_alloc)
+#define NEW_NOTHROW throw()
+#endif
+
+namespace {
+
+// Every thread allocates, so whether to count is read atomically.
+// g_counted_thread is set before counting starts and only read after.
+SDL_atomic_t g_counting = {0};
+SDL_threadID g_counted_thread = 0;
+unsigned long g_allocs = 0;
+
+void* CountedNew(size_t size) {
+  if (SDL_AtomicGet(&g_counting) != 0 && SDL_ThreadID() == g_counted_thread) {
+    ++g_allocs;
+  }
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+// One pass of the script: hold right, then left.  The render loop speeds
+// the spin up for every second a direction is held, so each hold runs
+// through a few speeds.
+struct ScriptEvent {
+  Uint32 at_ms;
+  Uint32 type;
+  SDL_Keycode key;
+};
+
+const ScriptEvent kPass[] = {{0, SDL_KEYDOWN, SDLK_RIGHT},
+                             {2500, SDL_KEYUP, SDLK_RIGHT},
+                             {5000, SDL_KEYDOWN, SDLK_LEFT},
+                             {7500, SDL_KEYUP, SDLK_LEFT}};
+const Uint32 kPassMs = 10000;
+const int kPassEvents = sizeof(kPass) / sizeof(kPass[0]);
+
+void PushKey(Uint32 type, SDL_Keycode key) {
+  SDL_Event event;
+  SDL_zero(event);
+  event.type = type;
+  event.key.keysym.sym = key;
+  SDL_PushEvent(&event);
+}
+
+}  // namespace
+
+void* operator new(size_t size) NEW_THROWS { return CountedNew(size); }
+void* operator new[](size_t size) NEW_THROWS { return CountedNew(size); }
+void operator delete(void* p) NEW_NOTHROW { free(p); }
+void operator delete[](void* p) NEW_NOTHROW { free(p); }
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) NEW_NOTHROW { free(p); }
+void operator delete[](void* p, size_t) NEW_NOTHROW { free(p); }
+#endif
+
+namespace carousel {
+
+void StepSpinScript(bool loaded) {
+  // pass is -1 while waiting for images, 0 warming up, 1 counting and 2 once
+  // done.
+  static int pass = -1;
+  static int next_event = 0;
+  static Uint32 pass_start = 0;
+
+  const Uint32 now = SDL_GetTicks();
+  if (pass < 0) {
+    if (!loaded) {
+      return;
+    }
+    pass = 0;
+    pass_start = now;
+  }
+  if (pass > 1) {
+    return;
+  }
+
+  if (now - pass_start >= kPassMs) {
+    ++pass;
+    next_event = 0;
+    pass_start = now;
+    if (pass == 1) {
+      g_counted_thread = SDL_ThreadID();
+      SDL_AtomicSet(&g_counting, 1);
+    } else {
+      SDL_AtomicSet(&g_counting, 0);
+      PushKey(SDL_KEYDOWN, SDLK_ESCAPE);
+      PushKey(SDL_KEYUP, SDLK_ESCAPE);
+      return;
+    }
+  }
+
+  while (next_event < kPassEvents &&
+         now - pass_start >= kPass[next_event].at_ms) {
+    PushKey(kPass[next_event].type, kPass[next_event].key);
+    ++next_event;
+  }
+}
+
+unsigned long CountedAllocs() { return g_allocs; }
+
+}  // namespace carousel
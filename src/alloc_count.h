@@ -0,0 +1,24 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+// Only built with -DCOUNT_ALLOCS=ON.  Replaces operator new with one that
+// counts calls made by the render thread while a scripted spin plays, to
+// check the render loop does not allocate once it has warmed up.
+
+namespace carousel {
+
+/*
+ * Advance the scripted spin.  Call once per frame from the render thread.
+ * The script waits until loaded is true, plays once to warm up, then plays
+ * again while counting and finally queues an escape key press to quit.
+ */
+void StepSpinScript(bool loaded);
+
+/*
+ * operator new calls made by the render thread during the counted pass.
+ */
+unsigned long CountedAllocs();
+
+}  // namespace carousel
+
+#endif
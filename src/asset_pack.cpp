@@ -0,0 +1,147 @@
+#include "asset_pack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "mipmap.h"
+#include "res_path.h"
+
+namespace carousel {
+
+AssetPack::AssetPack() : map_(NULL), map_size_(0), header_(NULL) {}
+
+AssetPack::~AssetPack() { Close(); }
+
+bool AssetPack::Open(const std::string& path, int card_w, int card_h) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    // No pack is normal; loose images are used instead.
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PackHeader)) {
+    std::cerr << "Ignoring damaged asset pack " << path << std::endl;
+    close(fd);
+    return false;
+  }
+  map_size_ = st.st_size;
+  map_ = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED) {
+    std::cerr << "Could not map asset pack " << path << std::endl;
+    map_ = NULL;
+    return false;
+  }
+
+  const char* base = (const char*)map_;
+  header_ = (const PackHeader*)base;
+
+  int chain_w, chain_h;
+  MipChainSize(card_w, card_h, &chain_w, &chain_h);
+  if (memcmp(header_->magic, ASSET_PACK_MAGIC, sizeof(header_->magic)) != 0 ||
+      header_->version != ASSET_PACK_VERSION) {
+    std::cerr << "Ignoring asset pack " << path << " of unknown version"
+              << std::endl;
+    Close();
+    return false;
+  }
+  if ((int)header_->card_w != card_w || (int)header_->card_h != card_h ||
+      (int)header_->chain_w != chain_w || (int)header_->chain_h != chain_h) {
+    std::cerr << "Ignoring asset pack " << path << " built for "
+              << header_->card_w << "x" << header_->card_h << " cards, need "
+              << card_w << "x" << card_h << std::endl;
+    Close();
+    return false;
+  }
+
+  const size_t entries_end =
+      sizeof(PackHeader) + (size_t)header_->count * sizeof(PackEntry);
+  const size_t chain_bytes = (size_t)chain_w * chain_h * 4;
+  if (entries_end > map_size_) {
+    std::cerr << "Ignoring truncated asset pack " << path << std::endl;
+    Close();
+    return false;
+  }
+
+  const PackEntry* entries = (const PackEntry*)(base + sizeof(PackHeader));
+  for (Uint32 i = 0; i < header_->count; ++i) {
+    const PackEntry& entry = entries[i];
+    if ((size_t)entry.name_offset + entry.name_length > map_size_ ||
+        entry.data_offset + chain_bytes > map_size_) {
+      std::cerr << "Ignoring truncated asset pack " << path << std::endl;
+      Close();
+      return false;
+    }
+    Slot slot;
+    slot.entry = &entry;
+    slot.verified = false;
+    entries_[std::string(base + entry.name_offset, entry.name_length)] = slot;
+  }
+  return true;
+}
+
+void AssetPack::Close() {
+  if (map_ != NULL) {
+    munmap(map_, map_size_);
+  }
+  map_ = NULL;
+  map_size_ = 0;
+  header_ = NULL;
+  entries_.clear();
+}
+
+const PackEntry* AssetPack::Lookup(const std::string& file) {
+  std::map<std::string, Slot>::iterator it = entries_.find(file);
+  if (it == entries_.end()) {
+    return NULL;
+  }
+  if (!it->second.verified) {
+    // Only the metadata is looked at; the loose file is never opened.
+    std::string path = carousel::GetResourcePath() + file;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 ||
+        (Sint64)st.st_mtime != it->second.entry->source_mtime ||
+        (Uint64)st.st_size != it->second.entry->source_size) {
+      std::cerr << "Asset pack is stale for " << file << std::endl;
+      entries_.erase(it);
+      return NULL;
+    }
+    it->second.verified = true;
+  }
+  return it->second.entry;
+}
+
+const void* AssetPack::Find(const std::string& file) {
+  const PackEntry* entry = Lookup(file);
+  if (entry == NULL) {
+    return NULL;
+  }
+  return (const char*)map_ + entry->data_offset;
+}
+
+bool AssetPack::Prefetch(const std::string& file) {
+  const PackEntry* entry = Lookup(file);
+  if (entry == NULL) {
+    return false;
+  }
+  // data_offset is page aligned.
+  posix_madvise((char*)map_ + entry->data_offset,
+                (size_t)pitch() * chain_h(), POSIX_MADV_WILLNEED);
+  return true;
+}
+
+void AssetPack::Recheck(const std::string& file) {
+  std::map<std::string, Slot>::iterator it = entries_.find(file);
+  if (it != entries_.end()) {
+    it->second.verified = false;
+  }
+}
+
+}  // namespace carousel
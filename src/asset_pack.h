@@ -0,0 +1,94 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <SDL2/SDL.h>
+#include <map>
+#include <string>
+
+namespace carousel {
+
+// Name of the pack file inside the resource directory.
+#define ASSET_PACK_FILE "carousel.pack"
+
+#define ASSET_PACK_MAGIC "CRSLPAK1"
+#define ASSET_PACK_VERSION 1
+
+// Pixel data starts on a page boundary so it can be mapped and uploaded
+// without copying.
+#define ASSET_PACK_ALIGN 4096
+
+/*
+ * On disk layout, all fields in host byte order:
+ *
+ *   PackHeader
+ *   PackEntry[count]
+ *   names (not terminated, see PackEntry)
+ *   padding to ASSET_PACK_ALIGN
+ *   pixels, one ARGB8888 mip chain of chain_w x chain_h per entry
+ */
+struct PackHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 card_w;
+  Uint32 card_h;
+  Uint32 chain_w;
+  Uint32 chain_h;
+  Uint32 count;
+};
+
+struct PackEntry {
+  Uint64 data_offset;
+  Uint32 name_offset;
+  Uint32 name_length;
+  // The loose file the pixels were made from, to detect a stale pack.
+  Sint64 source_mtime;
+  Uint64 source_size;
+};
+
+// Memory mapped pack of card images that are already decoded and resampled
+// to a given card size.  Built offline by CarouselPack.
+class AssetPack {
+ public:
+  AssetPack();
+  ~AssetPack();
+
+  // Map the pack at path.  Fails if it is missing, damaged or was built for a
+  // different card size.
+  bool Open(const std::string& path, int card_w, int card_h);
+  void Close();
+
+  // Mip chain for file, laid out as described by MipLayout(), or NULL if it
+  // is not in the pack or the loose file changed since the pack was built.
+  const void* Find(const std::string& file);
+  // Ask the kernel to start reading file's pixels in.  Returns false if file
+  // is not usable from the pack, as for Find().
+  bool Prefetch(const std::string& file);
+  // The loose file changed; check the entry against it again before use.
+  void Recheck(const std::string& file);
+
+  int chain_w() const { return header_ == NULL ? 0 : header_->chain_w; }
+  int chain_h() const { return header_ == NULL ? 0 : header_->chain_h; }
+  int pitch() const { return chain_w() * 4; }
+
+ private:
+  AssetPack(const AssetPack&);
+  AssetPack& operator=(const AssetPack&);
+
+  struct Slot {
+    const PackEntry* entry;
+    // Whether the loose file has been checked against the entry yet.
+    bool verified;
+  };
+
+  const PackEntry* Lookup(const std::string& file);
+
+  void* map_;
+  size_t map_size_;
+  const PackHeader* header_;
+  // Entry per file name.  The entry is dropped once found to be stale.
+  std::map<std::string, Slot> entries_;
+};
+
+}  // namespace carousel
+
+#endif
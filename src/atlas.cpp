@@ -0,0 +1,143 @@
+#include "atlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace carousel {
+
+TextureAtlas::TextureAtlas() : cell_w_(0), cell_h_(0), page_size_(0) {}
+
+TextureAtlas::~TextureAtlas() { Clear(); }
+
+void TextureAtlas::SetCellSize(int w, int h) {
+  if (w == cell_w_ && h == cell_h_) {
+    return;
+  }
+  Clear();
+  cell_w_ = w;
+  cell_h_ = h;
+}
+
+bool TextureAtlas::Add(SDL_Renderer* ren, const void* pixels, int pitch,
+                       SDL_Texture** texture, SDL_Rect* rect) {
+  if (page_size_ == 0) {
+    SDL_RendererInfo info;
+    page_size_ = ATLAS_PAGE_SIZE;
+    if (SDL_GetRendererInfo(ren, &info) == 0) {
+      if (info.max_texture_width > 0) {
+        page_size_ = std::min(page_size_, info.max_texture_width);
+      }
+      if (info.max_texture_height > 0) {
+        page_size_ = std::min(page_size_, info.max_texture_height);
+      }
+    }
+  }
+
+  Page* page = NULL;
+  for (size_t i = 0; i < pages_.size() && page == NULL; ++i) {
+    if (pages_[i].num_used < (int)pages_[i].used.size()) {
+      page = &pages_[i];
+    }
+  }
+  if (page == NULL) {
+    if (!NewPage(ren)) {
+      return false;
+    }
+    page = &pages_.back();
+  }
+
+  int cell = 0;
+  while (page->used[cell]) {
+    ++cell;
+  }
+  rect->x = (cell % page->columns) * (cell_w_ + IMAGE_GUTTER);
+  rect->y = (cell / page->columns) * (cell_h_ + IMAGE_GUTTER);
+  rect->w = cell_w_;
+  rect->h = cell_h_;
+  if (SDL_UpdateTexture(page->texture, rect, pixels, pitch) != 0) {
+    std::cerr << "SDL_UpdateTexture Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+  page->used[cell] = true;
+  page->num_used++;
+  *texture = page->texture;
+  return true;
+}
+
+void TextureAtlas::Remove(SDL_Texture* texture, const SDL_Rect& rect) {
+  for (size_t i = 0; i < pages_.size(); ++i) {
+    Page& page = pages_[i];
+    if (page.texture != texture) {
+      continue;
+    }
+    int cell = (rect.y / (cell_h_ + IMAGE_GUTTER)) * page.columns +
+               rect.x / (cell_w_ + IMAGE_GUTTER);
+    if (page.used[cell]) {
+      page.used[cell] = false;
+      page.num_used--;
+    }
+    if (page.num_used == 0) {
+      SDL_DestroyTexture(page.texture);
+      pages_.erase(pages_.begin() + i);
+    }
+    return;
+  }
+}
+
+void TextureAtlas::Clear() {
+  for (size_t i = 0; i < pages_.size(); ++i) {
+    SDL_DestroyTexture(pages_[i].texture);
+  }
+  pages_.clear();
+}
+
+size_t TextureAtlas::AddBytes() const {
+  for (size_t i = 0; i < pages_.size(); ++i) {
+    if (pages_[i].num_used < (int)pages_[i].used.size()) {
+      return 0;
+    }
+  }
+  return PageBytes();
+}
+
+size_t TextureAtlas::BytesFor(int cells) const {
+  int columns, rows;
+  PageGrid(&columns, &rows);
+  const int per_page = columns * rows;
+  return (size_t)((cells + per_page - 1) / per_page) * PageBytes();
+}
+
+void TextureAtlas::PageGrid(int* columns, int* rows) const {
+  // Until the renderer has been asked, assume the largest page.
+  const int size = page_size_ > 0 ? page_size_ : ATLAS_PAGE_SIZE;
+  // A cell bigger than a page gets a page of its own.
+  *columns = std::max(1, size / (cell_w_ + IMAGE_GUTTER));
+  *rows = std::max(1, size / (cell_h_ + IMAGE_GUTTER));
+}
+
+size_t TextureAtlas::PageBytes() const {
+  int columns, rows;
+  PageGrid(&columns, &rows);
+  return (size_t)columns * (cell_w_ + IMAGE_GUTTER) * rows *
+         (cell_h_ + IMAGE_GUTTER) * 4;
+}
+
+bool TextureAtlas::NewPage(SDL_Renderer* ren) {
+  Page page;
+  PageGrid(&page.columns, &page.rows);
+  const int w = page.columns * (cell_w_ + IMAGE_GUTTER);
+  const int h = page.rows * (cell_h_ + IMAGE_GUTTER);
+  page.texture = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888,
+                                   SDL_TEXTUREACCESS_STATIC, w, h);
+  if (page.texture == NULL) {
+    std::cerr << "SDL_CreateTexture Error: atlas " << w << "x" << h << ","
+              << SDL_GetError() << std::endl;
+    return false;
+  }
+  page.num_used = 0;
+  page.used.resize(page.columns * page.rows, false);
+  pages_.push_back(page);
+  return true;
+}
+
+}  // namespace carousel
@@ -0,0 +1,78 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+#include "mipmap.h"
+
+namespace carousel {
+
+// Largest atlas page we create.  VideoCore IV cannot go beyond this and
+// bigger pages only waste memory on partially filled genres.
+#define ATLAS_PAGE_SIZE 2048
+
+// A card image as drawn: the texture holding it and where each level of its
+// mip chain is in that texture.
+struct CardImage {
+  SDL_Texture* texture;
+  SDL_Rect level[MIP_LEVELS];
+};
+
+// Packs images into a few large textures so that a carousel frame binds as
+// few textures as possible.  Every card image has the same size, so pages
+// are a grid of equal cells that can be handed out and given back one at a
+// time.
+class TextureAtlas {
+ public:
+  TextureAtlas();
+  ~TextureAtlas();
+
+  // Size of every image in the atlas.  Clears the atlas if it changes.
+  void SetCellSize(int w, int h);
+
+  // Copy cell sized ARGB8888 pixels into a free cell and report the page
+  // texture and where on it they went.  Returns false if no texture could be
+  // created for them.
+  bool Add(SDL_Renderer* ren, const void* pixels, int pitch,
+           SDL_Texture** texture, SDL_Rect* rect);
+  // Give back the cell at rect on texture.  Pages left empty are destroyed.
+  void Remove(SDL_Texture* texture, const SDL_Rect& rect);
+  // Destroy every page.  Images handed out before are no longer valid.
+  void Clear();
+
+  int NumPages() const { return pages_.size(); }
+  // Video memory the pages take, whatever is in them.
+  size_t bytes() const { return pages_.size() * PageBytes(); }
+  // Video memory the next Add() takes: none while a cell is free, otherwise
+  // a whole page.
+  size_t AddBytes() const;
+  // Video memory of the pages that would hold cells images.
+  size_t BytesFor(int cells) const;
+
+ private:
+  struct Page {
+    SDL_Texture* texture;
+    int columns;
+    int rows;
+    int num_used;
+    std::vector<bool> used;
+  };
+
+  TextureAtlas(const TextureAtlas&);
+  TextureAtlas& operator=(const TextureAtlas&);
+
+  bool NewPage(SDL_Renderer* ren);
+  // Cells across and down a page.
+  void PageGrid(int* columns, int* rows) const;
+  size_t PageBytes() const;
+
+  std::vector<Page> pages_;
+  int cell_w_;
+  int cell_h_;
+  int page_size_;
+};
+
+}  // namespace carousel
+
+#endif
@@ -1,18 +1,21 @@
 #include "carousel.h"
 
+#include <strings.h>
+
+#include <algorithm>
 #include <iostream>
 #include <libconfig.h++>
+#include <map>
+#include <set>
 
-namespace carousel {
+#include "config_snapshot.h"
+#include "res_path.h"
+#include "rom_import.h"
 
-// Custom comparator for sorting CarouselCard records.
-bool SortByY(const carousel::CarouselCard& lhs,
-             const carousel::CarouselCard& rhs) {
-  return lhs.y > rhs.y;
-}
+namespace carousel {
 
 Carousel::Carousel()
-    : fps(30),
+    : fps(0),
       num_slots(5),
       initial_speed(2),
       reverse_keys(false),
@@ -20,10 +23,23 @@ Carousel::Carousel()
       timeout(1800),
       mixer("PCM"),
       mixer_opened(false),
+      texture_budget(0),
+      residency_window(0),
+      layout("arc"),
+      log_wakeups(false),
+      stats_file("/tmp/carousel.stats"),
+      screensaver_release("genre"),
+      hot_reload(true),
+      resident(false),
+      readahead_dwell(0),
+      readahead_limit(256),
       background_texture(NULL),
       screensaver_texture(NULL),
       volume_texture(NULL),
       patience_texture(NULL),
+      placeholder_texture(NULL),
+      scene_texture(NULL),
+      draw_order(NULL),
       width(-1),
       height(-1),
       low_index(0),
@@ -43,51 +59,322 @@ Carousel::Carousel()
   carousel_pos.resize(num_slots);
 
   for (int i = 0; i < num_slots; i++) {
-    carousel_image[i] = NULL;
+    carousel_image[i].texture = NULL;
   }
 }
 
 Carousel::~Carousel() {}
 
-void Carousel::SetCarouselPositions(int xoffset) {
-  // Largest card is the one in the middle (representing the current selection)
-  int largest_h = (int)((double)height * HOME_HEIGHT_FACTOR);
-  int largest_w = (int)((double)largest_h / CARD_ASPECT);
+int CardStore::Add(int image_id, int emu_id, int rom_id, int genre_id,
+                   int title_id, Uint8 card_flags) {
+  image.push_back(image_id);
+  emu.push_back(emu_id);
+  rom.push_back(rom_id);
+  genre.push_back(genre_id);
+  title.push_back(title_id);
+  flags.push_back(card_flags);
+  return size() - 1;
+}
 
-  // sp is the space between cards (by center x/y position)
-  int sp = width / num_slots;
-  SDL_assert(abs(xoffset) <= sp);
+int CardStore::Copy(const CardStore& from, int i) {
+  return Add(from.image[i], from.emu[i], from.rom[i], from.genre[i],
+             from.title[i], from.flags[i]);
+}
 
-  for (int i = 0; i < num_slots; i++) {
-    // X positions are simply index (i) * spacing + provided xoffset
-    int sx = sp * i + xoffset;
-    // 180 degrees is divided evenly by slots - 1
-    double angle = (double)(i)*180 / (num_slots - 1);
-    // Calc what angle adjustment we need based on xoffset
-    double angle_adjust =
-        (double)xoffset / (double)sp * ((180.0 / (num_slots - 1)));
-    // Size factor (sf) is sin(angle + angle_adjust) so we go from 0 to 1.0 back
-    // to 0 across all
-    // slots.
-    double sf = sin((angle + angle_adjust) / 57.29);
-    // cx,cy are center positions for the cards, we center our x's horizontally
-    // since they started
-    // on the very left edge of the screen
-    int cx = sx + sp / 2;
-    int cy = height / 2;
-    carousel_pos[i].w = largest_w * sf;
-    carousel_pos[i].h = largest_h * sf;
-    carousel_pos[i].x = cx - carousel_pos[i].w / 2;
-    carousel_pos[i].y = cy - carousel_pos[i].h / 2;
+void CardStore::Clear() {
+  image.clear();
+  emu.clear();
+  rom.clear();
+  genre.clear();
+  title.clear();
+  flags.clear();
+}
+
+void CardStore::Swap(CardStore& other) {
+  image.swap(other.image);
+  emu.swap(other.emu);
+  rom.swap(other.rom);
+  genre.swap(other.genre);
+  title.swap(other.title);
+  flags.swap(other.flags);
+}
+
+void Carousel::CardSize(int* w, int* h) const {
+  *h = (int)((double)height * HOME_HEIGHT_FACTOR);
+  *w = (int)((double)*h / CARD_ASPECT);
+}
+
+void Carousel::UsedImages(std::set<std::string>* files) const {
+  files->clear();
+  for (int i = 0; i < cards.size(); ++i) {
+    if (cards.image[i] >= 0) {
+      files->insert(image_names.Get(cards.image[i]));
+    }
+  }
+  for (size_t i = 0; i < genres.size(); ++i) {
+    if (genres[i].image >= 0) {
+      files->insert(image_names.Get(genres[i].image));
+    }
   }
+  files->insert("back.bmp");
+}
+
+bool Carousel::BuildLayout() {
+  Layout* shape = MakeLayout(layout);
+  if (shape == NULL) {
+    std::cerr << "Unknown layout " << layout << std::endl;
+    return false;
+  }
+  LayoutGeometry geometry;
+  geometry.width = width;
+  geometry.height = height;
+  geometry.num_slots = num_slots;
+  CardSize(&geometry.card_w, &geometry.card_h);
+  layout_table.Build(*shape, geometry);
+  delete shape;
+  return true;
+}
+
+void Carousel::SetCarouselPositions(float xoffset) {
+  SDL_assert(fabs(xoffset) <= layout_table.spacing());
+  layout_table.Lookup(xoffset, &carousel_pos[0], &draw_order);
 }
 
 bool Carousel::ParseConfig() {
+  // An unchanged config is loaded from the snapshot of its last parse.
+  ConfigKey key;
+  const bool keyed = ReadConfigKey(CONFIG_FILE, &key);
+  if (keyed && LoadConfigSnapshot(CONFIG_SNAPSHOT_FILE, key, this)) {
+    ApplyConfig();
+    return true;
+  }
+
+  if (!ReadConfigFile()) {
+    return false;
+  }
+  ApplyConfig();
+  if (keyed) {
+    StoreConfigSnapshot(CONFIG_SNAPSHOT_FILE, key, *this);
+  }
+  return true;
+}
+
+bool Carousel::ReloadCards() {
+  ConfigKey key;
+  const bool keyed = ReadConfigKey(CONFIG_FILE, &key);
+
+  Carousel fresh;
+  if (!fresh.ReadConfigFile()) {
+    std::cerr << "Keeping the cards already loaded" << std::endl;
+    return false;
+  }
+  if (fresh.num_slots != num_slots) {
+    std::cerr << "numslots changed, restart to reload the config"
+              << std::endl;
+    return false;
+  }
+  // The next start gets all the new settings.
+  if (keyed) {
+    StoreConfigSnapshot(CONFIG_SNAPSHOT_FILE, key, fresh);
+  }
+
+  // Give the fresh images the ids they already have here, new ones after.
+  std::vector<int> image_ids(fresh.image_names.size());
+  for (int i = 0; i < fresh.image_names.size(); ++i) {
+    image_ids[i] = image_names.Intern(fresh.image_names.Get(i));
+  }
+  for (int i = 0; i < fresh.cards.size(); ++i) {
+    if (fresh.cards.image[i] >= 0) {
+      fresh.cards.image[i] = image_ids[fresh.cards.image[i]];
+    }
+  }
+  for (size_t i = 0; i < fresh.genres.size(); ++i) {
+    if (fresh.genres[i].image >= 0) {
+      fresh.genres[i].image = image_ids[fresh.genres[i].image];
+    }
+  }
+
+  genre_names.Swap(fresh.genre_names);
+  genres.swap(fresh.genres);
+  emulator_names.Swap(fresh.emulator_names);
+  emulators.swap(fresh.emulators);
+  roms.Swap(fresh.roms);
+  titles.Swap(fresh.titles);
+  cards.Swap(fresh.cards);
+  config_inputs.swap(fresh.config_inputs);
+  images.Reserve(image_names.size());
+  BuildSearchIndex();
+  return true;
+}
+
+namespace {
+
+// A card found by ImportCards(), before it is added.
+struct ImportedCard {
+  // Sorted on, the title or else the file name.
+  std::string key;
+  std::string file;
+  std::string image;
+  const MachineInfo* machine;
+
+  bool operator<(const ImportedCard& other) const {
+    int order = strcasecmp(key.c_str(), other.key.c_str());
+    return order != 0 ? order < 0 : file < other.file;
+  }
+};
+
+// file without its extension, the set name MAME knows it by.
+std::string Stem(const std::string& file) {
+  size_t dot = file.rfind('.');
+  return dot == std::string::npos || dot == 0 ? file : file.substr(0, dot);
+}
+
+}  // namespace
+
+bool Carousel::ImportCards(const std::vector<RomImport>& imports,
+                           const std::string& listxml,
+                           std::vector<CardStore>* genre_cards) {
+  // All the ROM directories and the images are read at once.  A snapshot
+  // made from them is stale as soon as any of them changes.
+  std::vector<std::string> dirs;
+  for (size_t i = 0; i < imports.size(); ++i) {
+    dirs.push_back(imports[i].dir);
+  }
+  dirs.push_back(GetResourcePath());
+  for (size_t i = 0; i < dirs.size(); ++i) {
+    config_inputs.push_back(StatConfigInput(dirs[i]));
+  }
+  // A directory that cannot be read imports nothing.
+  std::vector<std::vector<std::string> > entries;
+  ListDirectories(dirs, &entries);
+  const std::set<std::string> image_files(entries.back().begin(),
+                                          entries.back().end());
+
+  std::map<std::string, MachineInfo> machines;
+  if (!listxml.empty()) {
+    // Only the machines there are files for are kept.
+    std::set<std::string> wanted;
+    for (size_t i = 0; i < imports.size(); ++i) {
+      for (size_t j = 0; j < entries[i].size(); ++j) {
+        wanted.insert(Stem(entries[i][j]));
+      }
+    }
+    config_inputs.push_back(StatConfigInput(listxml));
+    if (!ReadListXml(listxml, wanted, &machines)) {
+      return false;
+    }
+  }
+
+  // Preferred image formats first.
+  static const char* const kImageExtensions[] = {".qoi", ".png", ".bmp"};
+  const int num_extensions =
+      sizeof(kImageExtensions) / sizeof(kImageExtensions[0]);
+
+  for (size_t i = 0; i < imports.size(); ++i) {
+    const RomImport& import = imports[i];
+
+    int emu_id = emulator_names.Find(import.emu);
+    if (emu_id < 0) {
+      std::cerr << "Unknown emulator " << import.emu << " for import of "
+                << import.dir << std::endl;
+      return false;
+    }
+
+    int genre_id = genre_names.Find(import.genre);
+    if (genre_id < 0) {
+      std::cerr << "Unknown genre " << import.genre << " for import of "
+                << import.dir << std::endl;
+      return false;
+    }
+
+    std::vector<ImportedCard> found;
+    int left_out = 0;
+    int no_image = 0;
+    for (size_t j = 0; j < entries[i].size(); ++j) {
+      const std::string& file = entries[i][j];
+      if (!import.extension.empty() && !HasExtension(file, import.extension)) {
+        continue;
+      }
+      ImportedCard card;
+      card.file = file;
+      card.key = Stem(file);
+
+      // With a listxml dump, only games it knows are imported.
+      card.machine = NULL;
+      if (!listxml.empty()) {
+        std::map<std::string, MachineInfo>::const_iterator it =
+            machines.find(card.key);
+        if (it == machines.end() || !it->second.runnable ||
+            (it->second.clone && !import.clones)) {
+          ++left_out;
+          continue;
+        }
+        card.machine = &it->second;
+      }
+
+      for (int e = 0; e < num_extensions && card.image.empty(); ++e) {
+        if (image_files.count(card.key + kImageExtensions[e]) != 0) {
+          card.image = card.key + kImageExtensions[e];
+        }
+      }
+      if (card.image.empty()) {
+        ++no_image;
+        continue;
+      }
+
+      if (card.machine != NULL && !card.machine->description.empty()) {
+        card.key = card.machine->description;
+      }
+      found.push_back(card);
+    }
+
+    std::sort(found.begin(), found.end());
+    for (size_t j = 0; j < found.size(); ++j) {
+      const ImportedCard& card = found[j];
+      const bool titled =
+          card.machine != NULL && !card.machine->description.empty();
+      (*genre_cards)[genre_id].Add(image_names.Intern(card.image), emu_id,
+                                   roms.Intern(card.file), -1,
+                                   titled ? titles.Intern(card.key) : -1, 0);
+    }
+
+    std::cerr << "Imported " << found.size() << " cards from " << import.dir;
+    if (left_out > 0) {
+      std::cerr << ", " << left_out << " not games or clones left out";
+    }
+    if (no_image > 0) {
+      std::cerr << ", " << no_image << " without an image left out";
+    }
+    std::cerr << std::endl;
+  }
+  return true;
+}
+
+void Carousel::ApplyConfig() {
+  high_index = num_slots - 1;
+  carousel_pos.resize(num_slots);
+  carousel_image.resize(num_slots);
+  for (int i = 0; i < num_slots; i++) {
+    carousel_image[i].texture = NULL;
+  }
+  images.SetBudget((size_t)texture_budget * 1024 * 1024);
+  images.Reserve(image_names.size());
+  BuildSearchIndex();
+}
+
+void Carousel::BuildSearchIndex() {
+  search.assign(genres.size(), SearchIndex());
+  for (size_t g = 0; g < genres.size(); ++g) {
+    search[g].Build(*this, g);
+  }
+}
+
+bool Carousel::ReadConfigFile() {
   libconfig::Config cfg;
 
   // Read the file. If there is an error, report it and exit.
   try {
-    cfg.readFile("carousel.cfg");
+    cfg.readFile(CONFIG_FILE);
   } catch (const libconfig::FileIOException& fioex) {
     std::cerr << "I/O error while reading file." << std::endl;
     return false;
@@ -100,7 +387,7 @@ bool Carousel::ParseConfig() {
   // fps
   try {
     int cfg_fps = cfg.lookup("fps");
-    if (cfg_fps < 12 || cfg_fps > 48) {
+    if (cfg_fps != 0 && (cfg_fps < 12 || cfg_fps > 240)) {
       std::cerr << "Ignoring out of range fps " << cfg_fps << std::endl;
     } else {
       fps = cfg_fps;
@@ -129,13 +416,6 @@ bool Carousel::ParseConfig() {
     return false;
   }
 
-  high_index = num_slots - 1;
-  carousel_pos.resize(num_slots);
-  carousel_image.resize(num_slots);
-  for (int i = 0; i < num_slots; i++) {
-    carousel_image[i] = NULL;
-  }
-
   // speed
   try {
     int cfg_speed = cfg.lookup("speed");
@@ -181,17 +461,136 @@ bool Carousel::ParseConfig() {
     // ignore
   }
 
+  // layout
+  try {
+    std::string cfg_layout;
+    if (cfg.lookupValue("layout", cfg_layout)) {
+      Layout* shape = MakeLayout(cfg_layout);
+      if (shape == NULL) {
+        std::cerr << "Ignoring unknown layout " << cfg_layout << std::endl;
+      } else {
+        layout = cfg_layout;
+        delete shape;
+      }
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // texture_budget
+  try {
+    int cfg_budget = cfg.lookup("texture_budget");
+    // Less than one atlas page would evict everything for every page.
+    if (cfg_budget != 0 && cfg_budget < 16) {
+      std::cerr << "Ignoring too small texture_budget " << cfg_budget
+                << std::endl;
+    } else {
+      texture_budget = cfg_budget;
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // residency_window
+  try {
+    int cfg_window = cfg.lookup("residency_window");
+    if (cfg_window < 0) {
+      std::cerr << "Ignoring bad residency_window " << cfg_window
+                << std::endl;
+    } else {
+      residency_window = cfg_window;
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // log_wakeups
+  try {
+    log_wakeups = cfg.lookup("log_wakeups");
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // stats_file
+  try {
+    cfg.lookupValue("stats_file", stats_file);
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // hot_reload
+  try {
+    hot_reload = cfg.lookup("hot_reload");
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // resident
+  try {
+    resident = cfg.lookup("resident");
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // readahead_dwell
+  try {
+    int cfg_dwell = cfg.lookup("readahead_dwell");
+    if (cfg_dwell < 0) {
+      std::cerr << "Ignoring bad readahead_dwell " << cfg_dwell << std::endl;
+    } else {
+      readahead_dwell = cfg_dwell;
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // readahead_limit
+  try {
+    int cfg_limit = cfg.lookup("readahead_limit");
+    if (cfg_limit < 1) {
+      std::cerr << "Ignoring bad readahead_limit " << cfg_limit << std::endl;
+    } else {
+      readahead_limit = cfg_limit;
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
+  // screensaver_release
+  try {
+    std::string cfg_release;
+    if (cfg.lookupValue("screensaver_release", cfg_release)) {
+      if (cfg_release != "none" && cfg_release != "genre" &&
+          cfg_release != "all") {
+        std::cerr << "Ignoring unknown screensaver_release " << cfg_release
+                  << std::endl;
+      } else {
+        screensaver_release = cfg_release;
+      }
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
+
   const libconfig::Setting& root = cfg.getRoot();
 
+  genre_names.Clear();
+  genres.clear();
+  emulator_names.Clear();
+  emulators.clear();
+  // Image names are only ever added to, so ids stay valid across reloads.
+  roms.Clear();
+  titles.Clear();
+  cards.Clear();
+  config_inputs.clear();
+
   // Register emulators.
-  // Add cards defined by config.
   try {
-    Emulator carousel_emulator;
-    const libconfig::Setting& emulators = root["emulators"];
-    int count = emulators.getLength();
+    const libconfig::Setting& config_emulators = root["emulators"];
+    int count = config_emulators.getLength();
 
     for (int i = 0; i < count; ++i) {
-      const libconfig::Setting& emulator = emulators[i];
+      const libconfig::Setting& emulator = config_emulators[i];
 
       std::string name, cmd;
 
@@ -202,50 +601,86 @@ bool Carousel::ParseConfig() {
         return false;
       }
 
-      carousel_emulator.cmd = cmd;
-
-      all_emulators[name] = carousel_emulator;
+      // A later entry with the same name replaces an earlier one.
+      int id = emulator_names.Intern(name);
+      if (id == (int)emulators.size()) {
+        emulators.push_back(Emulator());
+      }
+      emulators[id].cmd = cmd;
     }
   } catch (const libconfig::SettingNotFoundException& nfex) {
     std::cerr << "Config file is missing cards definition" << std::endl;
     return false;
   }
 
-  root_genre.name = "root";
-  root_genre.image_filename = "";
-  all_genres["root"] = root_genre;
-  all_genre_names.push_back("root");
+  // Cards are collected per genre, then laid out genre by genre.
+  std::vector<CardStore> genre_cards;
+  Genre no_cards;
+  no_cards.image = -1;
+  no_cards.parent = -1;
+  no_cards.first = 0;
+  no_cards.count = 0;
+
+  genre_names.Intern("root");
+  genres.push_back(no_cards);
+  genre_cards.push_back(CardStore());
 
   // Read genres
   try {
-    Genre carousel_genre;
-    const libconfig::Setting& genres = root["genres"];
-    int count = genres.getLength();
+    const libconfig::Setting& config_genres = root["genres"];
+    int count = config_genres.getLength();
 
+    // Parents may be defined after their children.
+    std::vector<std::string> parents(1);
     for (int i = 0; i < count; ++i) {
-      const libconfig::Setting& genre = genres[i];
+      const libconfig::Setting& genre = config_genres[i];
 
-      std::string name, img;
+      std::string name, img, parent = "root";
       if (!(genre.lookupValue("name", name) &&
             genre.lookupValue("image", img))) {
         std::cerr << "Config file contains invalid genre entry :" << i
                   << std::endl;
         return false;
       }
+      genre.lookupValue("parent", parent);
 
-      carousel_genre.name = name;
-      carousel_genre.image_filename = img;
-
-      all_genres[name] = carousel_genre;
-
-
-      all_genre_names.push_back(name);
+      int id = genre_names.Intern(name);
+      if (id == ROOT_GENRE) {
+        std::cerr << "Config file contains genre named root :" << i
+                  << std::endl;
+        return false;
+      }
+      if (id == (int)genres.size()) {
+        genres.push_back(no_cards);
+        genre_cards.push_back(CardStore());
+        parents.push_back(parent);
+      }
+      genres[id].image = image_names.Intern(img);
+      parents[id] = parent;
+    }
 
-      CarouselCard carousel_card;
-      carousel_card.image_filename = img;
-      carousel_card.genre = name;
-      carousel_card.back = false;
-      all_genres["root"].all_cards.push_back(carousel_card);
+    for (int id = 1; id < (int)genres.size(); ++id) {
+      genres[id].parent = genre_names.Find(parents[id]);
+      if (genres[id].parent < 0) {
+        std::cerr << "Unknown parent " << parents[id] << " for genre "
+                  << genre_names.Get(id) << std::endl;
+        return false;
+      }
+    }
+    for (int id = 1; id < (int)genres.size(); ++id) {
+      // Every genre must lead back up to root.
+      int up = id;
+      for (size_t depth = 0; up != ROOT_GENRE && depth < genres.size();
+           ++depth) {
+        up = genres[up].parent;
+      }
+      if (up != ROOT_GENRE) {
+        std::cerr << "Genre " << genre_names.Get(id) << " is inside itself"
+                  << std::endl;
+        return false;
+      }
+      genre_cards[genres[id].parent].Add(genres[id].image, -1, -1, id, -1,
+                                         0);
     }
   } catch (const libconfig::SettingNotFoundException& nfex) {
     std::cerr << "Config file is missing cards definition" << std::endl;
@@ -254,15 +689,14 @@ bool Carousel::ParseConfig() {
 
   // Add cards defined by config.
   try {
-    CarouselCard carousel_card;
-    const libconfig::Setting& cards = root["cards"];
-    int count = cards.getLength();
+    const libconfig::Setting& config_cards = root["cards"];
+    int count = config_cards.getLength();
 
     for (int i = 0; i < count; ++i) {
-      const libconfig::Setting& card = cards[i];
+      const libconfig::Setting& card = config_cards[i];
 
       // Only output the record if all of the expected fields are present.
-      std::string image, emu, rom, genre;
+      std::string image, emu, rom, genre, title;
       bool patience = false;
 
       if (!(card.lookupValue("image", image) && card.lookupValue("emu", emu) &&
@@ -274,63 +708,90 @@ bool Carousel::ParseConfig() {
 
       // patience
       card.lookupValue("patience", patience);
+      // title
+      card.lookupValue("title", title);
 
-      if (all_emulators.find(emu) == all_emulators.end()) {
+      int emu_id = emulator_names.Find(emu);
+      if (emu_id < 0) {
         std::cerr << "Unknown emulator " << emu << " for card index " << i
                   << std::endl;
         return false;
       }
 
-      if (all_genres.find(genre) == all_genres.end()) {
+      int genre_id = genre_names.Find(genre);
+      if (genre_id < 0) {
         std::cerr << "Unknown genre " << genre << " for card index " << i
                   << std::endl;
         return false;
       }
 
-      carousel_card.image_filename = image;
-      carousel_card.emu = emu;
-      carousel_card.rom = rom;
-      carousel_card.genre = genre;
-      carousel_card.patience = patience;
-      carousel_card.back = false;
-      carousel_card.index = all_genres[genre].all_cards.size();
-
-      all_genres[genre].all_cards.push_back(carousel_card);
+      genre_cards[genre_id].Add(image_names.Intern(image), emu_id,
+                                roms.Intern(rom), -1,
+                                title.empty() ? -1 : titles.Intern(title),
+                                patience ? CARD_PATIENCE : 0);
     }
   } catch (const libconfig::SettingNotFoundException& nfex) {
     std::cerr << "Config file is missing cards definition" << std::endl;
     return false;
   }
 
+  // Add cards found in ROM directories.
+  try {
+    const libconfig::Setting& config_imports = root["imports"];
+    int count = config_imports.getLength();
 
-  // Duplicate members of the each list until we have at least num_slots
-  // entries.
+    std::vector<RomImport> imports(count);
+    for (int i = 0; i < count; ++i) {
+      const libconfig::Setting& entry = config_imports[i];
 
-  for (unsigned int i = 0; i < all_genre_names.size(); ++i) {
-     std::string gn = all_genre_names.at(i);
+      RomImport& import = imports[i];
+      if (!(entry.lookupValue("dir", import.dir) &&
+            entry.lookupValue("emu", import.emu) &&
+            entry.lookupValue("genre", import.genre))) {
+        std::cerr << "Config file contains invalid import entry :" << i
+                  << std::endl;
+        return false;
+      }
+      entry.lookupValue("extension", import.extension);
+      import.clones = true;
+      entry.lookupValue("clones", import.clones);
+    }
+
+    std::string listxml;
+    cfg.lookupValue("listxml", listxml);
+    if (count > 0 && !ImportCards(imports, listxml, &genre_cards)) {
+      return false;
+    }
+  } catch (const libconfig::SettingNotFoundException& nfex) {
+    // ignore
+  }
 
-     if (all_genres[gn].all_cards.empty()) {
-       std::cerr << "No carousel cards configured for " << gn << std::endl;
-       return false;
-     }
+  const int back_image = image_names.Intern("back.bmp");
+  for (int g = 0; g < (int)genres.size(); ++g) {
+    const CardStore& from = genre_cards[g];
+    if (from.size() == 0) {
+      std::cerr << "No carousel cards configured for " << genre_names.Get(g)
+                << std::endl;
+      return false;
+    }
 
-     int repeat = 0;
-     while ((int)all_genres[gn].all_cards.size() < num_slots) {
-       carousel::CarouselCard card = all_genres[gn].all_cards.at(repeat);
-       card.index = all_genres[gn].all_cards.size();
-       all_genres[gn].all_cards.push_back(card);
-       repeat++;
-     }
+    genres[g].first = cards.size();
+    for (int i = 0; i < from.size(); ++i) {
+      cards.Copy(from, i);
+    }
 
-     // Append a back card to each genre except root
-     if (gn != "root") {
-       CarouselCard back_card;
-       back_card.image_filename = "back.bmp";
-       back_card.genre = "";
-       back_card.back = true;
-       all_genres[gn].all_cards.push_back(back_card);
-     }
+    // Duplicate members of the each list until we have at least num_slots
+    // entries.
+    for (int repeat = 0; cards.size() - genres[g].first < num_slots;
+         ++repeat) {
+      cards.Copy(from, repeat % from.size());
+    }
 
+    // Append a back card to each genre except root
+    if (g != ROOT_GENRE) {
+      cards.Add(back_image, -1, -1, -1, -1, CARD_BACK);
+    }
+    genres[g].count = cards.size() - genres[g].first;
   }
 
   return true;
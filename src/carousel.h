@@ -2,10 +2,16 @@
 #define CAROUSEL_H
 
 #include <SDL2/SDL.h>
-#include <map>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "layout.h"
+#include "search_index.h"
+#include "string_table.h"
+#include "texture_cache.h"
+
 #ifdef ALSA_FOUND
 #include <alsa/asoundlib.h>
 #include <alsa/mixer.h>
@@ -17,6 +23,9 @@
 // Used to determine card width given a height.
 #define CARD_ASPECT 1.372
 
+// Read from the working directory.
+#define CONFIG_FILE "carousel.cfg"
+
 // Max rotation speed.
 #define MAX_SPEED 10
 
@@ -24,35 +33,76 @@
 #define DIR_RIGHT 1
 #define DIR_NONE 0
 
-namespace carousel {
+// The top of the genre tree is always genre 0.
+#define ROOT_GENRE 0
 
-struct CarouselCard {
-  int index;
-  int y;
+// CardStore::flags
+#define CARD_PATIENCE 1
+#define CARD_BACK 2
 
-  std::string image_filename;
-  std::string emu;
-  std::string rom;
-  std::string genre;
-  bool patience;
-  bool back;
+namespace carousel {
+
+// Every card of every genre, one array per field so a card costs a few ints
+// and walking a genre touches contiguous memory.  A genre's cards are
+// consecutive, see Genre.
+struct CardStore {
+  // Id in Carousel::image_names.
+  std::vector<int> image;
+  // Index in Carousel::emulators, -1 for genre and back cards.
+  std::vector<int> emu;
+  // Id in Carousel::roms, -1 for genre and back cards.
+  std::vector<int> rom;
+  // Genre a genre card opens, -1 for every other card.
+  std::vector<int> genre;
+  // Id in Carousel::titles, -1 if the card has no title.
+  std::vector<int> title;
+  // CARD_PATIENCE, CARD_BACK.
+  std::vector<Uint8> flags;
+
+  int size() const { return image.size(); }
+  // Append a card, returning its index.
+  int Add(int image_id, int emu_id, int rom_id, int genre_id, int title_id,
+          Uint8 card_flags);
+  // Append a copy of card i of from.
+  int Copy(const CardStore& from, int i);
+  void Clear();
+  void Swap(CardStore& other);
 };
 
 struct Emulator {
   std::string cmd;
 };
 
-struct Genre {
-  std::vector<CarouselCard> all_cards;
-  std::string name;
-  std::string image_filename;
+// A file or directory besides the config file that the cards were made
+// from, as it was when read.
+struct ConfigInput {
+  std::string path;
+  // -1 if it did not exist.
+  Sint64 mtime;
+  Uint64 size;
 };
 
-bool SortByY(const carousel::CarouselCard& lhs,
-             const carousel::CarouselCard& rhs);
+struct RomImport;
+
+// A place in the genre tree: the name of each genre from root down to the
+// open one, with the index of its selected card.
+typedef std::vector<std::pair<std::string, int> > GenrePath;
+
+// Genres form a tree under root.  A genre's cards are the cards of its
+// child genres followed by its games.
+struct Genre {
+  // Image of the genre's card in its parent, -1 for root.
+  int image;
+  // -1 for root.
+  int parent;
+  // Cards first to first + count - 1 of Carousel::cards.
+  int first;
+  int count;
+};
 
 class Carousel {
  public:
+  // Frame rate cap, 0 to run at the display's refresh rate.
   int fps;
   int num_slots;
   int initial_speed;
@@ -61,17 +111,48 @@ class Carousel {
   int timeout;
   std::string mixer;
   bool mixer_opened;
+  // Megabytes of card images kept resident across genres.
+  int texture_budget;
+  // Cards either side of the visible ones kept loaded, 0 for whole genres.
+  int residency_window;
+  // Shape of the carousel, a name MakeLayout() knows.
+  std::string layout;
+  // Report how often the render loop wakes up, to check idle behaviour.
+  bool log_wakeups;
+  // Where render loop statistics are written on SIGUSR1 and at exit.
+  std::string stats_file;
+  // Card images given back while the screen saver shows: "none", "genre"
+  // or "all" (those of the genres above it too).
+  std::string screensaver_release;
+  // Pick up changes to carousel.cfg and card images while running.
+  bool hot_reload;
+  // Run the chosen game ourselves and come back to the menu when it exits,
+  // instead of printing its command and exiting.
+  bool resident;
+  // Start reading the selected game's ROM files once the carousel has
+  // stopped on it this many ms, 0 never to.
+  int readahead_dwell;
+  // Megabytes of a game's ROM files read ahead at most.
+  int readahead_limit;
 
   SDL_Texture* background_texture;
   SDL_Texture* screensaver_texture;
   SDL_Texture* volume_texture;
   SDL_Texture* patience_texture;
-  // Root images remain resident for the lifetime of the carousel.  Images for
-  // the selected genre are kept in genre_images and released when leaving it.
-  std::map<std::string, SDL_Texture*> root_images;
-  std::map<std::string, SDL_Texture*> genre_images;
-  std::vector<SDL_Texture*> carousel_image;
-  std::vector<SDL_Rect> carousel_pos;
+  // Shown in place of card images that have not finished loading.
+  SDL_Texture* placeholder_texture;
+  // Background and cards at rest, drawn again only when they change.  NULL
+  // without render target support.
+  SDL_Texture* scene_texture;
+  // Card images of every genre.  The current genre's and those the genres
+  // above it show are pinned; images of genres left behind stay until the
+  // budget needs their space.
+  TextureCache images;
+  std::vector<CardImage> carousel_image;
+  std::vector<SDL_FRect> carousel_pos;
+  // Slots in the order to draw them, set along with carousel_pos.
+  const int* draw_order;
+  LayoutTable layout_table;
 
   int width;
   int height;
@@ -94,19 +175,65 @@ class Carousel {
   Uint8* blip_wav_buffer;
   SDL_AudioSpec click_wav_spec;
   SDL_AudioSpec blip_wav_spec;
-  Genre root_genre;
 
-  std::map<std::string, Emulator> all_emulators;
-  std::map<std::string, Genre> all_genres;
-  std::vector<std::string> all_genre_names;
+  // Genres and emulators are indexed by the id of their name.
+  StringTable genre_names;
+  std::vector<Genre> genres;
+  StringTable emulator_names;
+  std::vector<Emulator> emulators;
+  StringTable image_names;
+  StringTable roms;
+  // Game names, "Ms. Pac-Man", where known.
+  StringTable titles;
+  CardStore cards;
+  // Finds cards by name, one per genre.
+  std::vector<SearchIndex> search;
+  // ROM directories, the resource directory and listxml dump that imported
+  // cards came from.
+  std::vector<ConfigInput> config_inputs;
 
   Carousel();
   ~Carousel();
 
+  // Size of the card in the middle, the largest any card is drawn.
+  void CardSize(int* w, int* h) const;
+  // Files of the images some card or genre shows, back.bmp included.
+  // image_names may hold more after ReloadCards().
+  void UsedImages(std::set<std::string>* files) const;
+
+  // Precompute card positions for the configured layout.  Needs width,
+  // height and num_slots.
+  bool BuildLayout();
   // Move all visible carousel cards to their home position + xoffset.
   // Where -width / num_slots < xoffset < width / num_slots
-  void SetCarouselPositions(int xoffset);
+  void SetCarouselPositions(float xoffset);
+  // Index in cards of card index of genre.
+  int Card(int genre, int index) const { return genres[genre].first + index; }
+  // Read carousel.cfg, or the snapshot of it made by an earlier run if the
+  // file has not changed since (see config_snapshot.h).
   bool ParseConfig();
+  // Parse carousel.cfg again while running and take its cards, genres and
+  // emulators.  Other settings wait for a restart.  Image ids handed out
+  // before keep naming the same files, so image_names only grows; the
+  // snapshot written holds only the names still used, as a fresh parse
+  // would.  Returns false, changing nothing, if the file does not parse or
+  // changes numslots.
+  bool ReloadCards();
+
+ private:
+  // Parse carousel.cfg with libconfig.
+  bool ReadConfigFile();
+  // Add a card for each file of each import's ROM directory that has an
+  // image, to the import's genre in genre_cards.  listxml, if not empty,
+  // is the MAME -listxml dump used to name the cards and leave out what is
+  // not a game.
+  bool ImportCards(const std::vector<RomImport>& imports,
+                   const std::string& listxml,
+                   std::vector<CardStore>* genre_cards);
+  // Size what depends on the settings just read.
+  void ApplyConfig();
+  // Index the names of every genre's cards.
+  void BuildSearchIndex();
 };
 
 }  // namespace carousel
@@ -0,0 +1,452 @@
+#include "config_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "carousel.h"
+
+namespace carousel {
+
+namespace {
+
+// Collects the words and string table of a snapshot.
+class SnapshotWriter {
+ public:
+  void Int(int value) { words_.push_back((Uint32)value); }
+  void Bool(bool value) { words_.push_back(value ? 1 : 0); }
+  void Int64(Uint64 value) {
+    words_.push_back((Uint32)value);
+    words_.push_back((Uint32)(value >> 32));
+  }
+  void String(const std::string& value) {
+    std::map<std::string, Uint32>::iterator it = ids_.find(value);
+    if (it == ids_.end()) {
+      it = ids_.insert(std::make_pair(value, (Uint32)strings_.size())).first;
+      strings_.push_back(value);
+    }
+    words_.push_back(it->second);
+  }
+
+  void Table(const StringTable& table) {
+    Int(table.size());
+    for (int i = 0; i < table.size(); ++i) {
+      String(table.Get(i));
+    }
+  }
+  template <typename T>
+  void Array(const std::vector<T>& values) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      Int(values[i]);
+    }
+  }
+
+  const std::vector<Uint32>& words() const { return words_; }
+  const std::vector<std::string>& strings() const { return strings_; }
+
+ private:
+  std::vector<Uint32> words_;
+  std::vector<std::string> strings_;
+  std::map<std::string, Uint32> ids_;
+};
+
+// Reads back what SnapshotWriter wrote.  Running past the end or a bad
+// string id makes ok() false; the values read are then meaningless.
+class SnapshotReader {
+ public:
+  SnapshotReader(const Uint32* words, size_t num_words,
+                 const std::vector<std::string>& strings)
+      : words_(words),
+        num_words_(num_words),
+        pos_(0),
+        ok_(true),
+        strings_(strings) {}
+
+  int Int() {
+    if (pos_ >= num_words_) {
+      ok_ = false;
+      return 0;
+    }
+    return (int)words_[pos_++];
+  }
+  bool Bool() { return Int() != 0; }
+  Uint64 Int64() {
+    Uint64 low = (Uint32)Int();
+    return low | (Uint64)(Uint32)Int() << 32;
+  }
+  const std::string& String() {
+    Uint32 id = Int();
+    if (id >= strings_.size()) {
+      ok_ = false;
+      return empty_;
+    }
+    return strings_[id];
+  }
+  // Number of items that follow, each item_words long.  0 if that many do
+  // not fit in what is left.
+  size_t Count(size_t item_words) {
+    Uint32 count = Int();
+    if ((Uint64)count * item_words > num_words_ - pos_) {
+      ok_ = false;
+      return 0;
+    }
+    return count;
+  }
+
+  // Ids come back in the order they were written.
+  void Table(StringTable* table) {
+    size_t count = Count(1);
+    for (size_t i = 0; i < count; ++i) {
+      if (table->Intern(String()) != (int)i) {
+        ok_ = false;
+      }
+    }
+  }
+  // count values, each at least min and below limit.
+  template <typename T>
+  void Array(size_t count, int min, int limit, std::vector<T>* values) {
+    values->resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      int value = Int();
+      if (value < min || value >= limit) {
+        ok_ = false;
+      }
+      (*values)[i] = value;
+    }
+  }
+
+  bool ok() const { return ok_; }
+  bool done() const { return ok_ && pos_ == num_words_; }
+
+ private:
+  const Uint32* words_;
+  size_t num_words_;
+  size_t pos_;
+  bool ok_;
+  const std::vector<std::string>& strings_;
+  std::string empty_;
+};
+
+}  // namespace
+
+bool ReadConfigKey(const std::string& path, ConfigKey* key) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  std::vector<char> data;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok) {
+    data.resize(st.st_size);
+    ok = data.empty() ||
+         read(fd, &data[0], data.size()) == (ssize_t)data.size();
+  }
+  close(fd);
+  if (!ok) {
+    return false;
+  }
+
+  key->mtime = st.st_mtime;
+  key->size = st.st_size;
+  key->hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < data.size(); ++i) {
+    key->hash ^= (Uint8)data[i];
+    key->hash *= 0x100000001b3ULL;
+  }
+  return true;
+}
+
+ConfigInput StatConfigInput(const std::string& path) {
+  ConfigInput input;
+  input.path = path;
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) {
+    input.mtime = st.st_mtime;
+    input.size = st.st_size;
+  } else {
+    input.mtime = -1;
+    input.size = 0;
+  }
+  return input;
+}
+
+bool LoadConfigSnapshot(const std::string& path, const ConfigKey& key,
+                        Carousel* carousel) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  // The whole snapshot in one read, into words so the payload is aligned.
+  struct stat st;
+  std::vector<Uint32> data;
+  bool ok = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SnapshotHeader);
+  if (ok) {
+    data.resize((st.st_size + 3) / 4);
+    ok = read(fd, &data[0], st.st_size) == (ssize_t)st.st_size;
+  }
+  close(fd);
+  if (!ok) {
+    return false;
+  }
+
+  SnapshotHeader header;
+  memcpy(&header, &data[0], sizeof(header));
+  const Uint64 payload = st.st_size - sizeof(header);
+  if (memcmp(header.magic, CONFIG_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != CONFIG_SNAPSHOT_VERSION ||
+      header.config_mtime != key.mtime || header.config_size != key.size ||
+      header.config_hash != key.hash || header.payload_size != payload ||
+      ((Uint64)header.num_words + header.num_strings) * 4 > payload) {
+    // Made from another config, or by another version.
+    return false;
+  }
+
+  const Uint32* words = &data[sizeof(header) / 4];
+  const Uint32* lengths = words + header.num_words;
+  const char* bytes = (const char*)(lengths + header.num_strings);
+  Uint64 bytes_left = payload - ((Uint64)header.num_words +
+                                 header.num_strings) * 4;
+  std::vector<std::string> strings(header.num_strings);
+  for (Uint32 i = 0; i < header.num_strings; ++i) {
+    if (lengths[i] > bytes_left) {
+      return false;
+    }
+    strings[i].assign(bytes, lengths[i]);
+    bytes += lengths[i];
+    bytes_left -= lengths[i];
+  }
+  if (bytes_left != 0) {
+    return false;
+  }
+
+  // Same order as StoreConfigSnapshot().  Nothing is changed until all of it
+  // has been read.
+  SnapshotReader reader(words, header.num_words, strings);
+  int fps = reader.Int();
+  int num_slots = reader.Int();
+  int initial_speed = reader.Int();
+  bool reverse_keys = reader.Bool();
+  bool click = reader.Bool();
+  int timeout = reader.Int();
+  std::string mixer = reader.String();
+  int texture_budget = reader.Int();
+  int residency_window = reader.Int();
+  std::string layout = reader.String();
+  bool log_wakeups = reader.Bool();
+  std::string stats_file = reader.String();
+  std::string screensaver_release = reader.String();
+  bool hot_reload = reader.Bool();
+  bool resident = reader.Bool();
+  int readahead_dwell = reader.Int();
+  int readahead_limit = reader.Int();
+
+  StringTable genre_names, emulator_names, image_names, roms, titles;
+  reader.Table(&genre_names);
+  reader.Table(&emulator_names);
+  reader.Table(&image_names);
+  reader.Table(&roms);
+  reader.Table(&titles);
+
+  std::vector<ConfigInput> inputs(reader.Count(5));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    inputs[i].path = reader.String();
+    inputs[i].mtime = (Sint64)reader.Int64();
+    inputs[i].size = reader.Int64();
+  }
+
+  std::vector<Emulator> emulators(reader.Count(1));
+  for (size_t i = 0; i < emulators.size(); ++i) {
+    emulators[i].cmd = reader.String();
+  }
+
+  std::vector<Genre> genres(reader.Count(4));
+  for (size_t i = 0; i < genres.size(); ++i) {
+    genres[i].image = reader.Int();
+    genres[i].parent = reader.Int();
+    genres[i].first = reader.Int();
+    genres[i].count = reader.Int();
+  }
+
+  CardStore cards;
+  size_t count = reader.Count(6);
+  reader.Array(count, 0, image_names.size(), &cards.image);
+  reader.Array(count, -1, emulators.size(), &cards.emu);
+  reader.Array(count, -1, roms.size(), &cards.rom);
+  reader.Array(count, -1, genres.size(), &cards.genre);
+  reader.Array(count, -1, titles.size(), &cards.title);
+  reader.Array(count, 0, (CARD_PATIENCE | CARD_BACK) + 1, &cards.flags);
+
+  bool consistent = !genres.empty() &&
+                    genres.size() == (size_t)genre_names.size() &&
+                    emulators.size() == (size_t)emulator_names.size();
+  for (size_t i = 0; i < genres.size() && consistent; ++i) {
+    consistent = genres[i].first >= 0 && genres[i].count > 0 &&
+                 genres[i].first <= (int)count - genres[i].count &&
+                 (i == ROOT_GENRE ? genres[i].parent == -1
+                                  : genres[i].parent >= 0 &&
+                                        genres[i].parent < (int)genres.size());
+  }
+  // Parents lead up to root.
+  for (size_t i = 0; i < genres.size() && consistent; ++i) {
+    int up = i;
+    for (size_t depth = 0; up != ROOT_GENRE && depth < genres.size();
+         ++depth) {
+      up = genres[up].parent;
+    }
+    consistent = up == ROOT_GENRE;
+  }
+
+  if (!reader.done() || !consistent) {
+    std::cerr << "Ignoring damaged config snapshot " << path << std::endl;
+    return false;
+  }
+
+  // Imported cards are made again when what they came from changes.
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ConfigInput now = StatConfigInput(inputs[i].path);
+    if (now.mtime != inputs[i].mtime || now.size != inputs[i].size) {
+      return false;
+    }
+  }
+
+  carousel->fps = fps;
+  carousel->num_slots = num_slots;
+  carousel->initial_speed = initial_speed;
+  carousel->reverse_keys = reverse_keys;
+  carousel->click = click;
+  carousel->timeout = timeout;
+  carousel->mixer = mixer;
+  carousel->texture_budget = texture_budget;
+  carousel->residency_window = residency_window;
+  carousel->layout = layout;
+  carousel->log_wakeups = log_wakeups;
+  carousel->stats_file = stats_file;
+  carousel->screensaver_release = screensaver_release;
+  carousel->hot_reload = hot_reload;
+  carousel->resident = resident;
+  carousel->readahead_dwell = readahead_dwell;
+  carousel->readahead_limit = readahead_limit;
+  carousel->genre_names.Swap(genre_names);
+  carousel->genres.swap(genres);
+  carousel->emulator_names.Swap(emulator_names);
+  carousel->emulators.swap(emulators);
+  carousel->image_names.Swap(image_names);
+  carousel->roms.Swap(roms);
+  carousel->titles.Swap(titles);
+  carousel->cards.Swap(cards);
+  carousel->config_inputs.swap(inputs);
+  return true;
+}
+
+void StoreConfigSnapshot(const std::string& path, const ConfigKey& key,
+                         const Carousel& carousel) {
+  SnapshotWriter writer;
+  writer.Int(carousel.fps);
+  writer.Int(carousel.num_slots);
+  writer.Int(carousel.initial_speed);
+  writer.Bool(carousel.reverse_keys);
+  writer.Bool(carousel.click);
+  writer.Int(carousel.timeout);
+  writer.String(carousel.mixer);
+  writer.Int(carousel.texture_budget);
+  writer.Int(carousel.residency_window);
+  writer.String(carousel.layout);
+  writer.Bool(carousel.log_wakeups);
+  writer.String(carousel.stats_file);
+  writer.String(carousel.screensaver_release);
+  writer.Bool(carousel.hot_reload);
+  writer.Bool(carousel.resident);
+  writer.Int(carousel.readahead_dwell);
+  writer.Int(carousel.readahead_limit);
+
+  writer.Table(carousel.genre_names);
+  writer.Table(carousel.emulator_names);
+  writer.Table(carousel.image_names);
+  writer.Table(carousel.roms);
+  writer.Table(carousel.titles);
+
+  writer.Int(carousel.config_inputs.size());
+  for (size_t i = 0; i < carousel.config_inputs.size(); ++i) {
+    const ConfigInput& input = carousel.config_inputs[i];
+    writer.String(input.path);
+    writer.Int64(input.mtime);
+    writer.Int64(input.size);
+  }
+
+  writer.Int(carousel.emulators.size());
+  for (size_t i = 0; i < carousel.emulators.size(); ++i) {
+    writer.String(carousel.emulators[i].cmd);
+  }
+
+  writer.Int(carousel.genres.size());
+  for (size_t i = 0; i < carousel.genres.size(); ++i) {
+    writer.Int(carousel.genres[i].image);
+    writer.Int(carousel.genres[i].parent);
+    writer.Int(carousel.genres[i].first);
+    writer.Int(carousel.genres[i].count);
+  }
+
+  const CardStore& cards = carousel.cards;
+  writer.Int(cards.size());
+  writer.Array(cards.image);
+  writer.Array(cards.emu);
+  writer.Array(cards.rom);
+  writer.Array(cards.genre);
+  writer.Array(cards.title);
+  writer.Array(cards.flags);
+
+  const std::vector<Uint32>& words = writer.words();
+  const std::vector<std::string>& strings = writer.strings();
+  std::vector<Uint32> lengths(strings.size());
+  std::string bytes;
+  for (size_t i = 0; i < strings.size(); ++i) {
+    lengths[i] = strings[i].size();
+    bytes += strings[i];
+  }
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CONFIG_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = CONFIG_SNAPSHOT_VERSION;
+  header.num_words = words.size();
+  header.num_strings = strings.size();
+  header.config_mtime = key.mtime;
+  header.config_size = key.size;
+  header.config_hash = key.hash;
+  header.payload_size =
+      (words.size() + lengths.size()) * sizeof(Uint32) + bytes.size();
+
+  // Renamed into place so a launch never reads half a snapshot.
+  std::ostringstream tmp;
+  tmp << path << "." << getpid() << ".tmp";
+  int fd = open(tmp.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return;
+  }
+  struct iovec parts[4];
+  parts[0].iov_base = &header;
+  parts[0].iov_len = sizeof(header);
+  parts[1].iov_base = (void*)(words.empty() ? NULL : &words[0]);
+  parts[1].iov_len = words.size() * sizeof(Uint32);
+  parts[2].iov_base = lengths.empty() ? NULL : &lengths[0];
+  parts[2].iov_len = lengths.size() * sizeof(Uint32);
+  parts[3].iov_base = (void*)bytes.data();
+  parts[3].iov_len = bytes.size();
+  ssize_t put = writev(fd, parts, 4);
+  bool ok = put == (ssize_t)(sizeof(header) + header.payload_size);
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmp.str().c_str(), path.c_str()) != 0) {
+    std::cerr << "Could not write config snapshot " << path << std::endl;
+    unlink(tmp.str().c_str());
+  }
+}
+
+}  // namespace carousel
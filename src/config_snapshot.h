@@ -0,0 +1,70 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <SDL2/SDL.h>
+#include <string>
+
+namespace carousel {
+
+class Carousel;
+struct ConfigInput;
+
+// Written next to the config file, in the working directory.
+#define CONFIG_SNAPSHOT_FILE "carousel.cfg.snap"
+
+#define CONFIG_SNAPSHOT_MAGIC "CRSLCFG1"
+// Bump whenever ParseConfig() sets something new or changes what it builds,
+// so snapshots of older parses are ignored.
+#define CONFIG_SNAPSHOT_VERSION 7
+
+/*
+ * On disk layout of a snapshot, all fields in host byte order:
+ *
+ *   SnapshotHeader
+ *   Uint32 words[num_words]          settings, counts and string ids
+ *   Uint32 lengths[num_strings]      string table
+ *   char bytes[]                     string table, not terminated
+ *
+ * Every string is stored once and referred to by its index in the table.
+ */
+struct SnapshotHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 num_words;
+  Uint32 num_strings;
+  Uint32 reserved;
+  // The config file the snapshot was made from.
+  Sint64 config_mtime;
+  Uint64 config_size;
+  Uint64 config_hash;
+  // Bytes following the header.
+  Uint64 payload_size;
+};
+
+// Identifies one version of the config file.
+struct ConfigKey {
+  Sint64 mtime;
+  Uint64 size;
+  // 64 bit FNV-1a of the contents.
+  Uint64 hash;
+};
+
+// Key for the config file at path.  False if it cannot be read.
+bool ReadConfigKey(const std::string& path, ConfigKey* key);
+// How path is now, for Carousel::config_inputs.
+ConfigInput StatConfigInput(const std::string& path);
+
+// Fill in everything ParseConfig() reads from the config file, if the
+// snapshot at path was made from the file key describes and none of its
+// config_inputs have changed since.  Returns false, leaving carousel
+// untouched, otherwise.
+bool LoadConfigSnapshot(const std::string& path, const ConfigKey& key,
+                        Carousel* carousel);
+// Save what ParseConfig() read from the file key describes.  Failures are
+// logged and ignored.
+void StoreConfigSnapshot(const std::string& path, const ConfigKey& key,
+                         const Carousel& carousel);
+
+}  // namespace carousel
+
+#endif
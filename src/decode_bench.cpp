@@ -0,0 +1,141 @@
+// Compares decoding the card images referenced by carousel.cfg as BMP, QOI
+// and PNG.  Each image is loaded once in whatever format it is stored in,
+// re-encoded in memory, and then every format is decoded from memory so
+// disk speed does not enter into it.
+//
+// Usage: CarouselDecodeBench [repeats]
+//
+// Run it from the directory holding carousel.cfg, like the carousel itself.
+
+#include <SDL2/SDL.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "carousel.h"
+#include "image_loader.h"
+#include "png_decoder.h"
+#include "qoi.h"
+
+namespace {
+
+enum Format { BMP, QOI, PNG, NUM_FORMATS };
+
+const char* const kFormatNames[NUM_FORMATS] = {"bmp", "qoi", "png"};
+
+struct Totals {
+  Uint64 bytes;
+  Uint64 ticks;
+  int failed;
+};
+
+SDL_Surface* Decode(Format format, const std::vector<Uint8>& data) {
+  switch (format) {
+    case BMP: {
+      SDL_Surface* bmp =
+          SDL_LoadBMP_RW(SDL_RWFromConstMem(&data[0], data.size()), 1);
+      if (bmp == NULL) {
+        return NULL;
+      }
+      SDL_Surface* converted =
+          SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_ARGB8888, 0);
+      SDL_FreeSurface(bmp);
+      return converted;
+    }
+    case QOI:
+      return carousel::DecodeQoi(&data[0], data.size());
+    case PNG:
+      return carousel::DecodePng(&data[0], data.size());
+    default:
+      return NULL;
+  }
+}
+
+bool EncodeBmp(SDL_Surface* image, std::vector<Uint8>* out) {
+  // Headers take well under 256 bytes.
+  out->resize((size_t)image->w * image->h * 4 + 256);
+  SDL_RWops* rw = SDL_RWFromMem(&(*out)[0], (int)out->size());
+  if (rw == NULL) {
+    return false;
+  }
+  const bool ok = SDL_SaveBMP_RW(image, rw, 0) == 0;
+  out->resize(ok ? (size_t)SDL_RWtell(rw) : 0);
+  SDL_RWclose(rw);
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int repeats = argc > 1 ? atoi(argv[1]) : 3;
+  if (repeats < 1) {
+    std::cerr << "Usage: " << argv[0] << " [repeats]" << std::endl;
+    return 1;
+  }
+
+  carousel::Carousel carousel;
+  if (!carousel.ParseConfig()) {
+    std::cerr << "Could not parse config file" << std::endl;
+    return 1;
+  }
+
+  std::set<std::string> names;
+  carousel.UsedImages(&names);
+
+  Totals totals[NUM_FORMATS] = {};
+  int images = 0;
+  for (std::set<std::string>::iterator it = names.begin(); it != names.end();
+       ++it) {
+    // DecodeImage() reports why it failed.
+    SDL_Surface* image = carousel::DecodeImage(*it);
+    if (image == NULL) {
+      std::cerr << "Skipping " << *it << std::endl;
+      continue;
+    }
+    std::vector<Uint8> encoded[NUM_FORMATS];
+    bool encoded_ok = EncodeBmp(image, &encoded[BMP]) &&
+                      carousel::EncodeQoi(image, &encoded[QOI]) &&
+                      carousel::EncodePng(image, &encoded[PNG]);
+    SDL_FreeSurface(image);
+    if (!encoded_ok) {
+      std::cerr << "Skipping " << *it << ", " << SDL_GetError() << std::endl;
+      continue;
+    }
+    ++images;
+
+    for (int f = 0; f < NUM_FORMATS; ++f) {
+      totals[f].bytes += encoded[f].size();
+      for (int r = 0; r < repeats; ++r) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        SDL_Surface* decoded = Decode((Format)f, encoded[f]);
+        totals[f].ticks += SDL_GetPerformanceCounter() - start;
+        if (decoded == NULL) {
+          totals[f].failed++;
+        }
+        SDL_FreeSurface(decoded);
+      }
+    }
+  }
+
+  if (images == 0) {
+    std::cerr << "No images to decode" << std::endl;
+    return 1;
+  }
+
+  const double freq = (double)SDL_GetPerformanceFrequency();
+  std::cout << images << " images, " << repeats << " decodes each"
+            << std::endl;
+  for (int f = 0; f < NUM_FORMATS; ++f) {
+    const double ms = totals[f].ticks * 1000.0 / freq / repeats;
+    std::cout << kFormatNames[f] << ": " << totals[f].bytes / 1024 << " KB, "
+              << ms << " ms per pass, " << ms / images << " ms per image";
+    if (totals[f].failed > 0) {
+      std::cout << ", " << totals[f].failed << " failed";
+    }
+    std::cout << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include "disk_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "mipmap.h"
+#include "res_path.h"
+
+namespace carousel {
+
+// 64 bit FNV-1a, to turn an image name into a file name.
+static Uint64 HashName(const std::string& name) {
+  Uint64 hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash ^= (Uint8)name[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static bool MakeDir(const std::string& path) {
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+DiskCache::DiskCache() : card_w_(0), card_h_(0), chain_w_(0), chain_h_(0) {}
+
+bool DiskCache::Open(int card_w, int card_h) {
+  std::ostringstream size;
+  size << card_w << "x" << card_h;
+  std::string top = carousel::GetResourcePath() + DISK_CACHE_DIR;
+  std::string dir = top + "/" + size.str();
+  if (!MakeDir(top) || !MakeDir(dir)) {
+    std::cerr << "Could not create image cache " << dir << ", "
+              << strerror(errno) << std::endl;
+    dir_.clear();
+    return false;
+  }
+  dir_ = dir + "/";
+  card_w_ = card_w;
+  card_h_ = card_h;
+  MipChainSize(card_w, card_h, &chain_w_, &chain_h_);
+  return true;
+}
+
+std::string DiskCache::EntryPath(const std::string& file) const {
+  if (dir_.empty() || file.size() >= DISK_CACHE_MAX_NAME) {
+    return "";
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.chain",
+           (unsigned long long)HashName(file));
+  return dir_ + name;
+}
+
+SDL_Surface* DiskCache::Load(const std::string& file) const {
+  std::string path = EntryPath(file);
+  if (path.empty()) {
+    return NULL;
+  }
+  struct stat st;
+  std::string source = carousel::GetResourcePath() + file;
+  if (stat(source.c_str(), &st) != 0) {
+    return NULL;
+  }
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  SDL_Surface* chain = SDL_CreateRGBSurfaceWithFormat(
+      0, chain_w_, chain_h_, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (chain == NULL) {
+    close(fd);
+    return NULL;
+  }
+
+  // Header and pixels in one read.  32 bit surfaces have no row padding.
+  CacheHeader header;
+  struct iovec parts[2];
+  parts[0].iov_base = &header;
+  parts[0].iov_len = sizeof(header);
+  parts[1].iov_base = chain->pixels;
+  parts[1].iov_len = (size_t)chain->pitch * chain->h;
+  ssize_t got = readv(fd, parts, 2);
+  close(fd);
+
+  if (got != (ssize_t)(parts[0].iov_len + parts[1].iov_len) ||
+      memcmp(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != DISK_CACHE_VERSION ||
+      (int)header.card_w != card_w_ || (int)header.card_h != card_h_ ||
+      (int)header.chain_w != chain_w_ || (int)header.chain_h != chain_h_ ||
+      header.source_mtime != (Sint64)st.st_mtime ||
+      header.source_size != (Uint64)st.st_size ||
+      strncmp(header.name, file.c_str(), sizeof(header.name)) != 0) {
+    // Stale or for another image; Store() will replace it.
+    SDL_FreeSurface(chain);
+    return NULL;
+  }
+  return chain;
+}
+
+void DiskCache::Store(const std::string& file, SDL_Surface* chain) const {
+  std::string path = EntryPath(file);
+  if (path.empty() || chain->w != chain_w_ || chain->h != chain_h_) {
+    return;
+  }
+  struct stat st;
+  std::string source = carousel::GetResourcePath() + file;
+  if (stat(source.c_str(), &st) != 0) {
+    return;
+  }
+
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic));
+  header.version = DISK_CACHE_VERSION;
+  header.card_w = card_w_;
+  header.card_h = card_h_;
+  header.chain_w = chain_w_;
+  header.chain_h = chain_h_;
+  header.source_mtime = st.st_mtime;
+  header.source_size = st.st_size;
+  strncpy(header.name, file.c_str(), sizeof(header.name) - 1);
+
+  // Written under a name unique to this thread and renamed into place, so a
+  // reader never sees a partial entry.
+  std::ostringstream tmp;
+  tmp << path << "." << SDL_ThreadID() << ".tmp";
+  int fd = open(tmp.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return;
+  }
+  struct iovec parts[2];
+  parts[0].iov_base = &header;
+  parts[0].iov_len = sizeof(header);
+  parts[1].iov_base = chain->pixels;
+  parts[1].iov_len = (size_t)chain->pitch * chain->h;
+  ssize_t put = writev(fd, parts, 2);
+  bool ok = put == (ssize_t)(parts[0].iov_len + parts[1].iov_len);
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmp.str().c_str(), path.c_str()) != 0) {
+    std::cerr << "Could not write image cache entry for " << file
+              << std::endl;
+    unlink(tmp.str().c_str());
+  }
+}
+
+}  // namespace carousel
@@ -0,0 +1,71 @@
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <SDL2/SDL.h>
+#include <string>
+
+namespace carousel {
+
+// Directory inside the resource directory that holds cached mip chains.
+#define DISK_CACHE_DIR "cache"
+
+#define DISK_CACHE_MAGIC "CRSLTHM1"
+#define DISK_CACHE_VERSION 1
+
+// Longest image file name that can be cached.
+#define DISK_CACHE_MAX_NAME 256
+
+/*
+ * On disk layout of one cache entry, all fields in host byte order:
+ *
+ *   CacheHeader
+ *   pixels, one ARGB8888 mip chain of chain_w x chain_h
+ *
+ * The header is a fixed size so the whole entry is read with one call.
+ */
+struct CacheHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 card_w;
+  Uint32 card_h;
+  Uint32 chain_w;
+  Uint32 chain_h;
+  Uint32 reserved;
+  // The loose file the pixels were made from.
+  Sint64 source_mtime;
+  Uint64 source_size;
+  char name[DISK_CACHE_MAX_NAME];
+};
+
+// Card images already resampled to one card size, kept on disk between runs
+// so a restart does not have to decode and resample them again.  One file
+// per image under res/cache/<card_w>x<card_h>/.  Load and Store may be
+// called from any thread once Open has returned.
+class DiskCache {
+ public:
+  DiskCache();
+
+  // Use the cache directory for card_w x card_h cards, creating it if
+  // needed.  Returns false, leaving the cache disabled, if it cannot be made.
+  bool Open(int card_w, int card_h);
+
+  // Mip chain for file, or NULL if it is not cached or the loose file
+  // changed since it was.  The caller owns the surface.
+  SDL_Surface* Load(const std::string& file) const;
+  // Save the mip chain built for file.  Failures are logged and ignored.
+  void Store(const std::string& file, SDL_Surface* chain) const;
+
+ private:
+  // Entry path for file, or empty if file cannot be cached.
+  std::string EntryPath(const std::string& file) const;
+
+  std::string dir_;
+  int card_w_;
+  int card_h_;
+  int chain_w_;
+  int chain_h_;
+};
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,159 @@
+#include "file_watch.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace carousel {
+
+FileWatcher::FileWatcher()
+    : fd_(-1),
+      config_wd_(-1),
+      resource_wd_(-1),
+      event_type_((Uint32)-1),
+      wake_fd_(-1),
+      lock_(NULL),
+      config_changed_(false) {}
+
+#ifdef __linux__
+
+bool FileWatcher::Start(const std::string& config_file,
+                        const std::string& resource_dir, Uint32 event_type,
+                        int wake_fd) {
+  if (fd_ >= 0) {
+    return true;
+  }
+  fd_ = inotify_init1(IN_CLOEXEC);
+  if (fd_ < 0) {
+    std::cerr << "Could not start inotify: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  // The config is watched through its directory since editors usually
+  // replace the file rather than write to it.
+  config_name_ = config_file;
+  config_wd_ = inotify_add_watch(fd_, ".", IN_CLOSE_WRITE | IN_MOVED_TO);
+  resource_wd_ = inotify_add_watch(
+      fd_, resource_dir.c_str(),
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+  lock_ = SDL_CreateMutex();
+  if (config_wd_ < 0 || resource_wd_ < 0 || lock_ == NULL) {
+    std::cerr << "Could not watch " << config_file << " and " << resource_dir
+              << " for changes" << std::endl;
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  event_type_ = event_type;
+  wake_fd_ = wake_fd;
+
+  SDL_Thread* thread = SDL_CreateThread(WatchMain, "FileWatcher", this);
+  if (thread == NULL) {
+    std::cerr << "Could not start file watcher thread: " << SDL_GetError()
+              << std::endl;
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  SDL_DetachThread(thread);
+  return true;
+}
+
+int FileWatcher::WatchMain(void* data) {
+  static_cast<FileWatcher*>(data)->Watch();
+  return 0;
+}
+
+void FileWatcher::Watch() {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t len = read(fd_, buf, sizeof(buf));
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+    if (len <= 0) {
+      std::cerr << "File watcher stopped: " << strerror(errno) << std::endl;
+      return;
+    }
+    bool changed = Parse(buf, len);
+
+    // Keep collecting until the burst is over.
+    struct pollfd quiet;
+    quiet.fd = fd_;
+    quiet.events = POLLIN;
+    while (poll(&quiet, 1, FILE_WATCH_SETTLE_MS) > 0) {
+      len = read(fd_, buf, sizeof(buf));
+      if (len > 0) {
+        changed = Parse(buf, len) || changed;
+      }
+    }
+
+    if (changed) {
+      SDL_Event event;
+      SDL_zero(event);
+      event.type = event_type_;
+      SDL_PushEvent(&event);
+      if (wake_fd_ >= 0) {
+        // A full pipe wakes the reader all the same.
+        ssize_t written = write(wake_fd_, "", 1);
+        (void)written;
+      }
+    }
+  }
+}
+
+bool FileWatcher::Parse(const char* buf, size_t len) {
+  bool changed = false;
+  SDL_LockMutex(lock_);
+  for (size_t pos = 0; pos < len;) {
+    const struct inotify_event* event =
+        reinterpret_cast<const struct inotify_event*>(buf + pos);
+    pos += sizeof(struct inotify_event) + event->len;
+    if (event->len == 0 || (event->mask & IN_ISDIR) != 0) {
+      continue;
+    }
+    if (event->wd == config_wd_ && config_name_ == event->name) {
+      config_changed_ = true;
+      changed = true;
+    }
+    // The working directory may be the resource directory too.
+    if (event->wd == resource_wd_) {
+      files_.insert(event->name);
+      changed = true;
+    }
+  }
+  SDL_UnlockMutex(lock_);
+  return changed;
+}
+
+#else
+
+bool FileWatcher::Start(const std::string&, const std::string&, Uint32,
+                        int) {
+  std::cerr << "Watching for changes is only supported on Linux" << std::endl;
+  return false;
+}
+
+#endif
+
+void FileWatcher::TakeChanges(bool* config_changed,
+                              std::set<std::string>* files) {
+  files->clear();
+  *config_changed = false;
+  if (lock_ == NULL) {
+    return;
+  }
+  SDL_LockMutex(lock_);
+  *config_changed = config_changed_;
+  config_changed_ = false;
+  files->swap(files_);
+  SDL_UnlockMutex(lock_);
+}
+
+}  // namespace carousel
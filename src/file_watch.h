@@ -0,0 +1,52 @@
+#ifndef FILE_WATCH_H
+#define FILE_WATCH_H
+
+#include <SDL2/SDL.h>
+#include <set>
+#include <string>
+
+namespace carousel {
+
+// How long a burst of changes must have been quiet for before it is
+// reported, in ms.  Editors and copies write a file in several steps.
+#define FILE_WATCH_SETTLE_MS 250
+
+// Watches the config file and the resource directory with inotify.  A
+// thread waits for changes and pushes an SDL event of the given type once
+// they settle, and writes a byte to a wake pipe if given one; the render
+// thread then takes what changed.  Only available
+// on Linux; elsewhere Start() fails and nothing is watched.
+class FileWatcher {
+ public:
+  FileWatcher();
+
+  // Watch config_file (in the working directory) and the files directly in
+  // resource_dir.  The thread lives until the process exits.  wake_fd is
+  // -1 for none.
+  bool Start(const std::string& config_file, const std::string& resource_dir,
+             Uint32 event_type, int wake_fd);
+
+  // Whether the config file changed, and the names of the resource files
+  // that did, since the last call.
+  void TakeChanges(bool* config_changed, std::set<std::string>* files);
+
+ private:
+  static int WatchMain(void* data);
+  void Watch();
+  // Note the events in buf.  Returns true if any were of interest.
+  bool Parse(const char* buf, size_t len);
+
+  int fd_;
+  int config_wd_;
+  int resource_wd_;
+  std::string config_name_;
+  Uint32 event_type_;
+  int wake_fd_;
+  SDL_mutex* lock_;
+  bool config_changed_;
+  std::set<std::string> files_;
+};
+
+}  // namespace carousel
+
+#endif
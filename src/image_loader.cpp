@@ -0,0 +1,243 @@
+#include "image_loader.h"
+
+#include <iostream>
+#include <vector>
+
+#include "disk_cache.h"
+#include "mipmap.h"
+#include "png_decoder.h"
+#include "qoi.h"
+#include "res_path.h"
+
+namespace carousel {
+
+// Whole contents of the file at path, or false if it cannot be read.
+static bool ReadFile(const std::string& path, std::vector<Uint8>* data) {
+  SDL_RWops* rw = SDL_RWFromFile(path.c_str(), "rb");
+  if (rw == NULL) {
+    return false;
+  }
+  Sint64 size = SDL_RWsize(rw);
+  bool ok = size >= 0;
+  if (ok) {
+    data->resize(size);
+    ok = size == 0 || SDL_RWread(rw, &(*data)[0], size, 1) == 1;
+  }
+  SDL_RWclose(rw);
+  return ok;
+}
+
+SDL_Surface* DecodeImage(const std::string& file) {
+  std::string imagePath = carousel::GetResourcePath() + file;
+
+  // QOI and PNG are decoded straight to ARGB8888.  Anything else is taken to
+  // be a BMP, as before.
+  const bool qoi = HasExtension(file, ".qoi");
+  if (qoi || HasExtension(file, ".png")) {
+    std::vector<Uint8> data;
+    if (!ReadFile(imagePath, &data)) {
+      std::cerr << "Could not read image " << file << "," << SDL_GetError()
+                << std::endl;
+      return NULL;
+    }
+    const Uint8* bytes = data.empty() ? NULL : &data[0];
+    SDL_Surface* image = qoi ? DecodeQoi(bytes, data.size())
+                             : DecodePng(bytes, data.size());
+    if (image == NULL) {
+      std::cerr << "Could not decode image " << file << "," << SDL_GetError()
+                << std::endl;
+    }
+    return image;
+  }
+
+  SDL_Surface* bmp = SDL_LoadBMP(imagePath.c_str());
+  if (bmp == NULL) {
+    std::cerr << "SDL_LoadBMP Error: " << file << "," << SDL_GetError()
+              << std::endl;
+    return NULL;
+  }
+
+  // Convert here so the render thread does not have to when uploading.
+  SDL_Surface* converted =
+      SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface(bmp);
+  if (converted == NULL) {
+    std::cerr << "SDL_ConvertSurfaceFormat Error: " << file << ","
+              << SDL_GetError() << std::endl;
+  }
+  return converted;
+}
+
+ImageLoader::ImageLoader()
+    : card_w_(0),
+      card_h_(0),
+      lock_(NULL),
+      wake_(NULL),
+      stopping_(false) {}
+
+ImageLoader::~ImageLoader() { Stop(); }
+
+bool ImageLoader::Start(int card_w, int card_h, int num_threads) {
+  if (!threads_.empty()) {
+    return true;
+  }
+  card_w_ = card_w;
+  card_h_ = card_h;
+
+  // Resolve the resource path before any worker can race to do it.
+  carousel::GetResourcePath();
+  // Runs without a cache if the resource directory is read only.
+  cache_.Open(card_w, card_h);
+
+  lock_ = SDL_CreateMutex();
+  wake_ = SDL_CreateCond();
+  if (lock_ == NULL || wake_ == NULL) {
+    std::cerr << "Could not create image loader lock: " << SDL_GetError()
+              << std::endl;
+    Stop();
+    return false;
+  }
+
+  if (num_threads < 1) {
+    num_threads = SDL_GetCPUCount();
+  }
+
+  stopping_ = false;
+  for (int i = 0; i < num_threads; ++i) {
+    SDL_Thread* thread = SDL_CreateThread(WorkerMain, "ImageLoader", this);
+    if (thread == NULL) {
+      std::cerr << "Could not start image loader thread: " << SDL_GetError()
+                << std::endl;
+      break;
+    }
+    threads_.push_back(thread);
+  }
+
+  if (threads_.empty()) {
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+void ImageLoader::Stop() {
+  if (lock_ != NULL) {
+    SDL_LockMutex(lock_);
+    stopping_ = true;
+    pending_.clear();
+    SDL_CondBroadcast(wake_);
+    SDL_UnlockMutex(lock_);
+  }
+
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    SDL_WaitThread(threads_[i], NULL);
+  }
+  threads_.clear();
+
+  for (size_t i = 0; i < done_.size(); ++i) {
+    SDL_FreeSurface(done_[i].surface);
+  }
+  done_.clear();
+  in_flight_.clear();
+
+  if (wake_ != NULL) {
+    SDL_DestroyCond(wake_);
+    wake_ = NULL;
+  }
+  if (lock_ != NULL) {
+    SDL_DestroyMutex(lock_);
+    lock_ = NULL;
+  }
+}
+
+void ImageLoader::Request(const std::string& file) {
+  SDL_LockMutex(lock_);
+  pending_.push_back(file);
+  SDL_CondSignal(wake_);
+  SDL_UnlockMutex(lock_);
+}
+
+void ImageLoader::Replace(const std::vector<std::string>& files) {
+  SDL_LockMutex(lock_);
+  pending_.clear();
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (in_flight_.find(files[i]) != in_flight_.end()) {
+      continue;
+    }
+    bool decoded = false;
+    for (size_t j = 0; j < done_.size() && !decoded; ++j) {
+      decoded = done_[j].file == files[i];
+    }
+    if (!decoded) {
+      pending_.push_back(files[i]);
+    }
+  }
+  SDL_CondBroadcast(wake_);
+  SDL_UnlockMutex(lock_);
+}
+
+bool ImageLoader::Collect(std::string* file, SDL_Surface** surface) {
+  SDL_LockMutex(lock_);
+  if (done_.empty()) {
+    SDL_UnlockMutex(lock_);
+    return false;
+  }
+  *file = done_.front().file;
+  *surface = done_.front().surface;
+  done_.pop_front();
+  SDL_UnlockMutex(lock_);
+  return true;
+}
+
+int ImageLoader::Outstanding() {
+  SDL_LockMutex(lock_);
+  int outstanding = pending_.size() + in_flight_.size() + done_.size();
+  SDL_UnlockMutex(lock_);
+  return outstanding;
+}
+
+int ImageLoader::WorkerMain(void* data) {
+  // Decoding must never compete with the render thread.
+  SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+  static_cast<ImageLoader*>(data)->Work();
+  return 0;
+}
+
+void ImageLoader::Work() {
+  SDL_LockMutex(lock_);
+  while (!stopping_) {
+    if (pending_.empty()) {
+      SDL_CondWait(wake_, lock_);
+      continue;
+    }
+
+    Result result;
+    result.file = pending_.front();
+    pending_.pop_front();
+    in_flight_.insert(result.file);
+    SDL_UnlockMutex(lock_);
+
+    result.surface = cache_.Load(result.file);
+    if (result.surface == NULL) {
+      SDL_Surface* decoded = DecodeImage(result.file);
+      if (decoded != NULL) {
+        result.surface = BuildMipChain(decoded, card_w_, card_h_);
+        SDL_FreeSurface(decoded);
+      }
+      if (result.surface != NULL) {
+        cache_.Store(result.file, result.surface);
+      }
+    }
+
+    SDL_LockMutex(lock_);
+    in_flight_.erase(result.file);
+    if (stopping_) {
+      SDL_FreeSurface(result.surface);
+    } else {
+      done_.push_back(result);
+    }
+  }
+  SDL_UnlockMutex(lock_);
+}
+
+}  // namespace carousel
@@ -0,0 +1,73 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <SDL2/SDL.h>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "disk_cache.h"
+
+namespace carousel {
+
+/*
+ * Decode an image resource into a surface.  Safe to call from any thread;
+ * file is relative to the resource path.
+ */
+SDL_Surface* DecodeImage(const std::string& file);
+
+// Decodes card images on a pool of worker threads.  Only decoding happens off
+// the render thread; decoded surfaces are collected by the render thread which
+// turns them into textures.  Each card is resampled to the size it is shown at
+// and delivered as a mip chain (see mipmap.h).  Chains are kept in a
+// DiskCache so later runs skip decoding and resampling.
+class ImageLoader {
+ public:
+  ImageLoader();
+  ~ImageLoader();
+
+  // Start num_threads workers producing card_w x card_h mip chains.  When
+  // num_threads < 1, one worker per core.
+  bool Start(int card_w, int card_h, int num_threads = 0);
+  // Stop all workers and free any decoded surfaces that were not collected.
+  void Stop();
+
+  // Queue file for decoding.
+  void Request(const std::string& file);
+  // Replace every queued request with files, decoded in the order given.
+  // Files already being decoded, or decoded and not yet collected, are not
+  // queued again.
+  void Replace(const std::vector<std::string>& files);
+
+  // Take one decoded image.  Returns false when nothing is ready.  surface is
+  // NULL if the image could not be decoded; the caller owns it otherwise.
+  bool Collect(std::string* file, SDL_Surface** surface);
+
+  // Number of requests queued or being decoded.
+  int Outstanding();
+
+ private:
+  struct Result {
+    std::string file;
+    SDL_Surface* surface;
+  };
+
+  static int WorkerMain(void* data);
+  void Work();
+
+  int card_w_;
+  int card_h_;
+  DiskCache cache_;
+  SDL_mutex* lock_;
+  SDL_cond* wake_;
+  bool stopping_;
+  std::set<std::string> in_flight_;
+  std::deque<std::string> pending_;
+  std::deque<Result> done_;
+  std::vector<SDL_Thread*> threads_;
+};
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,238 @@
+#include "input_trace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace carousel {
+
+#define TRACE_MAGIC "carousel-trace"
+#define TRACE_VERSION 2
+
+InputTrace::InputTrace()
+    : recording_(false),
+      replaying_(false),
+      origin_(SDL_GetPerformanceCounter()),
+      frame_micros_(0),
+      frame_(-1),
+      event_(0),
+      drawn_(0),
+      layout_total_(0),
+      copy_total_(0),
+      present_total_(0),
+      present_max_(0) {}
+
+InputTrace::~InputTrace() {}
+
+bool InputTrace::StartRecording(const std::string& path) {
+  out_.open(path.c_str(), std::ofstream::out | std::ofstream::trunc);
+  if (out_.fail()) {
+    std::cerr << "Could not write trace " << path << std::endl;
+    return false;
+  }
+  out_ << TRACE_MAGIC << " " << TRACE_VERSION << std::endl;
+  origin_ = SDL_GetPerformanceCounter();
+  recording_ = true;
+  return true;
+}
+
+bool InputTrace::StartReplay(const std::string& path) {
+  std::ifstream in(path.c_str());
+  if (in.fail()) {
+    std::cerr << "Could not read trace " << path << std::endl;
+    return false;
+  }
+  std::string magic;
+  int version = 0;
+  in >> magic >> version;
+  if (magic != TRACE_MAGIC || version < 1 || version > TRACE_VERSION) {
+    std::cerr << "Not a carousel trace " << path << std::endl;
+    return false;
+  }
+
+  std::string line;
+  int line_number = 1;
+  while (std::getline(in, line)) {
+    ++line_number;
+    std::istringstream fields(line);
+    std::string kind;
+    if (!(fields >> kind)) {
+      continue;
+    }
+    bool ok = true;
+    if (kind == "start" && version == 1) {
+      std::string genre;
+      int genre_index, start_index;
+      ok = static_cast<bool>(fields >> genre >> genre_index >> start_index);
+      start_.clear();
+      if (genre == "root") {
+        start_.push_back(std::make_pair(genre, start_index));
+      } else {
+        start_.push_back(std::make_pair(std::string("root"), genre_index));
+        start_.push_back(std::make_pair(genre, start_index));
+      }
+    } else if (kind == "start") {
+      std::string genre;
+      int index;
+      start_.clear();
+      while (fields >> genre >> index) {
+        start_.push_back(std::make_pair(genre, index));
+      }
+      ok = !start_.empty() && fields.eof();
+    } else if (kind == "frame") {
+      Frame frame;
+      ok = static_cast<bool>(fields >> frame.micros);
+      frames_.push_back(frame);
+    } else if (kind == "event" && !frames_.empty()) {
+      Uint32 type;
+      int a, b;
+      ok = static_cast<bool>(fields >> type >> a >> b);
+      SDL_Event event;
+      SDL_zero(event);
+      event.type = type;
+      switch (type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+          event.key.keysym.sym = a;
+          event.key.repeat = b;
+          event.key.state = type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+          break;
+        case SDL_MOUSEMOTION:
+          event.motion.xrel = a;
+          event.motion.yrel = b;
+          break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+          event.button.button = a;
+          event.button.clicks = b;
+          break;
+        default:
+          break;
+      }
+      frames_.back().events.push_back(event);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::cerr << "Bad trace line " << path << ":" << line_number
+                << std::endl;
+      return false;
+    }
+  }
+  replaying_ = true;
+  return true;
+}
+
+void InputTrace::RecordStart(const GenrePath& path) {
+  if (recording_) {
+    out_ << "start";
+    for (size_t i = 0; i < path.size(); ++i) {
+      out_ << " " << path[i].first << " " << path[i].second;
+    }
+    out_ << std::endl;
+  }
+}
+
+void InputTrace::ReplayStart(GenrePath* path) const {
+  if (replaying_ && !start_.empty()) {
+    *path = start_;
+  }
+}
+
+Uint64 InputTrace::RealMicros() const {
+  return (SDL_GetPerformanceCounter() - origin_) * 1000000 /
+         SDL_GetPerformanceFrequency();
+}
+
+bool InputTrace::NextFrame() {
+  if (replaying_) {
+    if (frame_ + 1 >= (int)frames_.size()) {
+      return false;
+    }
+    ++frame_;
+    event_ = 0;
+    frame_micros_ = frames_[frame_].micros;
+    return true;
+  }
+  frame_micros_ = RealMicros();
+  if (recording_) {
+    out_ << "frame " << frame_micros_ << "\n";
+  }
+  return true;
+}
+
+Uint32 InputTrace::Ticks() const {
+  return (replaying_ ? frame_micros_ : RealMicros()) / 1000;
+}
+
+int InputTrace::PollEvent(SDL_Event* event) {
+  if (replaying_) {
+    // Keep the real queue drained of input; only recorded input counts.
+    // Everything else, such as a stats request, still gets through.
+    while (SDL_PollEvent(event)) {
+      if (event->type < SDL_KEYDOWN || event->type >= SDL_CLIPBOARDUPDATE) {
+        return 1;
+      }
+    }
+    if (frame_ < 0 || event_ >= frames_[frame_].events.size()) {
+      return 0;
+    }
+    *event = frames_[frame_].events[event_++];
+    return 1;
+  }
+
+  if (!SDL_PollEvent(event)) {
+    return 0;
+  }
+  if (recording_) {
+    switch (event->type) {
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+        out_ << "event " << event->type << " " << event->key.keysym.sym << " "
+             << (int)event->key.repeat << "\n";
+        break;
+      case SDL_MOUSEMOTION:
+        out_ << "event " << event->type << " " << event->motion.xrel << " "
+             << event->motion.yrel << "\n";
+        break;
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+        out_ << "event " << event->type << " " << (int)event->button.button
+             << " " << (int)event->button.clicks << "\n";
+        break;
+      default:
+        // Nothing else reaches the carousel.
+        break;
+    }
+  }
+  return 1;
+}
+
+void InputTrace::FrameTimings(Uint64 layout, Uint64 copy, Uint64 present) {
+  if (!replaying_) {
+    return;
+  }
+  ++drawn_;
+  layout_total_ += layout;
+  copy_total_ += copy;
+  present_total_ += present;
+  present_max_ = std::max(present_max_, present);
+
+  const double us = 1000000.0 / SDL_GetPerformanceFrequency();
+  std::cerr << "frame " << frame_ << " layout " << layout * us << "us copy "
+            << copy * us << "us present " << present * us << "us" << std::endl;
+}
+
+void InputTrace::PrintSummary() const {
+  if (!replaying_ || drawn_ == 0) {
+    return;
+  }
+  const double us = 1000000.0 / SDL_GetPerformanceFrequency();
+  std::cerr << "Replayed " << frames_.size() << " frames, drew " << drawn_
+            << ". Mean layout " << layout_total_ * us / drawn_ << "us copy "
+            << copy_total_ * us / drawn_ << "us present "
+            << present_total_ * us / drawn_ << "us, worst present "
+            << present_max_ * us << "us" << std::endl;
+}
+
+}  // namespace carousel
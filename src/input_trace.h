@@ -0,0 +1,97 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <SDL2/SDL.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "carousel.h"
+
+namespace carousel {
+
+// Records the input the render loop sees, frame by frame, or plays a
+// recording back.  During playback time is virtual: every frame gets the
+// time it had when recorded and the events it polled then, however long it
+// takes to draw, so a replay runs the same way every time and as fast as the
+// renderer allows.  Replays also time the parts of each frame.
+//
+// Trace files are text, one line per frame or event:
+//
+//   carousel-trace 2
+//   start <genre> <index> [<genre> <index> ...]
+//   frame <microseconds since start>
+//   event <type> <a> <b>
+//
+// where a and b are the key and repeat flag for key events, the relative
+// motion for mouse motion and the button and clicks for mouse buttons.
+// start holds the GenrePath the carousel opened at.  Version 1 traces, whose
+// start line is the open genre, the root index and the start index, still
+// play.
+class InputTrace {
+ public:
+  InputTrace();
+  ~InputTrace();
+
+  bool StartRecording(const std::string& path);
+  bool StartReplay(const std::string& path);
+  bool recording() const { return recording_; }
+  bool replaying() const { return replaying_; }
+
+  // The carousel's saved selection at the start.  Recordings store it and
+  // replays restore it.
+  void RecordStart(const GenrePath& path);
+  void ReplayStart(GenrePath* path) const;
+
+  // Begin a render loop iteration.  Returns false once a replay has played
+  // every recorded frame.
+  bool NextFrame();
+  // Milliseconds since the trace started.  Virtual during a replay.
+  Uint32 Ticks() const;
+  // Microseconds since the trace started, as of NextFrame().
+  Uint64 frame_micros() const { return frame_micros_; }
+
+  // Use in place of SDL_PollEvent().  Replays return the recorded input and
+  // drop real input; other events, the carousel's own included, pass.
+  int PollEvent(SDL_Event* event);
+
+  // Report how long, in performance counter ticks, a drawn frame spent
+  // placing cards, copying them and presenting.  Printed during replays.
+  void FrameTimings(Uint64 layout, Uint64 copy, Uint64 present);
+  // Print totals over the replay.
+  void PrintSummary() const;
+
+ private:
+  struct Frame {
+    Uint64 micros;
+    std::vector<SDL_Event> events;
+  };
+
+  InputTrace(const InputTrace&);
+  InputTrace& operator=(const InputTrace&);
+
+  Uint64 RealMicros() const;
+
+  bool recording_;
+  bool replaying_;
+  std::ofstream out_;
+  Uint64 origin_;
+  Uint64 frame_micros_;
+
+  GenrePath start_;
+  std::vector<Frame> frames_;
+  // Frame being played, and its next event.  frame_ is -1 before the first.
+  int frame_;
+  size_t event_;
+
+  // Replay timing totals, in performance counter ticks.
+  int drawn_;
+  Uint64 layout_total_;
+  Uint64 copy_total_;
+  Uint64 present_total_;
+  Uint64 present_max_;
+};
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,123 @@
+#include "layout.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace carousel {
+
+namespace {
+
+// The original carousel: cards grow from nothing at the edges to full size in
+// the middle along half a sine wave.
+class ArcLayout : public Layout {
+ public:
+  SDL_FRect Place(const LayoutGeometry& geometry, float pos) const {
+    const float sp = geometry.width / geometry.num_slots;
+    // 180 degrees is divided evenly by slots - 1
+    const double angle = pos * 180.0 / (geometry.num_slots - 1);
+    const float sf = std::max(0.0, sin(angle / 57.29));
+    return Centered(geometry, sp * pos + sp / 2, geometry.height / 2.0f, sf);
+  }
+
+ protected:
+  static SDL_FRect Centered(const LayoutGeometry& geometry, float cx, float cy,
+                            float scale) {
+    SDL_FRect rect;
+    rect.w = geometry.card_w * scale;
+    rect.h = geometry.card_h * scale;
+    rect.x = cx - rect.w / 2;
+    rect.y = cy - rect.h / 2;
+    return rect;
+  }
+};
+
+// Cover flow: the selection at full size and every other card at half size,
+// easing between the two over one slot.  Like the arc, cards shrink away to
+// nothing in the end slots.
+class FlatLayout : public ArcLayout {
+ public:
+  SDL_FRect Place(const LayoutGeometry& geometry, float pos) const {
+    const float sp = geometry.width / geometry.num_slots;
+    const float last = geometry.num_slots - 1;
+    const float distance = std::min(1.0f, (float)fabs(pos - last / 2));
+    const float edge = std::max(0.0f, std::min(1.0f, std::min(pos, last - pos)));
+    return Centered(geometry, sp * pos + sp / 2, geometry.height / 2.0f,
+                    (1.0f - distance / 2) * edge);
+  }
+};
+
+// The arc, rising from the bottom left to the top right of the screen.
+class TiltLayout : public ArcLayout {
+ public:
+  SDL_FRect Place(const LayoutGeometry& geometry, float pos) const {
+    SDL_FRect rect = ArcLayout::Place(geometry, pos);
+    const float middle = (geometry.num_slots - 1) / 2.0f;
+    rect.y -= (pos - middle) / middle * geometry.height / 8;
+    return rect;
+  }
+};
+
+// Orders slot indexes smallest card first, so bigger cards overlap smaller
+// ones and the largest is drawn last.
+class BySize {
+ public:
+  explicit BySize(const SDL_FRect* rects) : rects_(rects) {}
+  bool operator()(int lhs, int rhs) const {
+    return rects_[lhs].w < rects_[rhs].w;
+  }
+
+ private:
+  const SDL_FRect* rects_;
+};
+
+}  // namespace
+
+Layout* MakeLayout(const std::string& name) {
+  if (name == "arc") {
+    return new ArcLayout();
+  } else if (name == "flat") {
+    return new FlatLayout();
+  } else if (name == "tilt") {
+    return new TiltLayout();
+  }
+  return NULL;
+}
+
+LayoutTable::LayoutTable() : sp_(0), num_slots_(0) {}
+
+void LayoutTable::Build(const Layout& layout, const LayoutGeometry& geometry) {
+  sp_ = geometry.width / geometry.num_slots;
+  num_slots_ = geometry.num_slots;
+  const int steps = 2 * sp_ + 1;
+  rects_.resize(steps * num_slots_);
+  order_.resize(steps * num_slots_);
+  for (int step = 0; step < steps; ++step) {
+    const float offset = (float)(step - sp_) / sp_;
+    SDL_FRect* rects = &rects_[step * num_slots_];
+    int* order = &order_[step * num_slots_];
+    for (int i = 0; i < num_slots_; ++i) {
+      rects[i] = layout.Place(geometry, i + offset);
+      order[i] = i;
+    }
+    // Stable so cards of equal size keep a fixed order.
+    std::stable_sort(order, order + num_slots_, BySize(rects));
+  }
+}
+
+void LayoutTable::Lookup(float xoffset, SDL_FRect* pos,
+                         const int** order) const {
+  const float at = std::max(0.0f, std::min((float)(2 * sp_), xoffset + sp_));
+  const int step = std::min((int)at, 2 * sp_ - 1);
+  const float frac = at - step;
+  const SDL_FRect* a = &rects_[step * num_slots_];
+  const SDL_FRect* b = a + num_slots_;
+  for (int i = 0; i < num_slots_; ++i) {
+    pos[i].x = a[i].x + (b[i].x - a[i].x) * frac;
+    pos[i].y = a[i].y + (b[i].y - a[i].y) * frac;
+    pos[i].w = a[i].w + (b[i].w - a[i].w) * frac;
+    pos[i].h = a[i].h + (b[i].h - a[i].h) * frac;
+  }
+  *order = &order_[(frac < 0.5f ? step : step + 1) * num_slots_];
+}
+
+}  // namespace carousel
@@ -0,0 +1,65 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+namespace carousel {
+
+// Everything a layout may base card placement on.
+struct LayoutGeometry {
+  int width;
+  int height;
+  int num_slots;
+  // Size of the card in the middle, the largest any card is drawn.
+  int card_w;
+  int card_h;
+};
+
+// Shape of the carousel: where a card is drawn for a given position along
+// it.  Only used to fill a LayoutTable, never per frame.
+class Layout {
+ public:
+  virtual ~Layout() {}
+
+  // Rectangle of a card at pos, in slots from the left edge.  Cards sit at
+  // whole positions 0 to num_slots - 1 at rest and move between them while
+  // spinning.  The end slots are offscreen or empty.
+  virtual SDL_FRect Place(const LayoutGeometry& geometry,
+                          float pos) const = 0;
+};
+
+/*
+ * New layout by its carousel.cfg name ("arc", "flat" or "tilt"), or NULL if
+ * there is no such layout.
+ */
+Layout* MakeLayout(const std::string& name);
+
+// Card rectangles and draw order for every slot at every whole pixel spin
+// offset, so a frame only has to look them up.
+class LayoutTable {
+ public:
+  LayoutTable();
+
+  void Build(const Layout& layout, const LayoutGeometry& geometry);
+
+  // Rectangles of all slots when spun by xoffset pixels, where
+  // -spacing() <= xoffset <= spacing(), and the order to draw the slots in,
+  // furthest back first.  Positions between whole pixels are interpolated.
+  void Lookup(float xoffset, SDL_FRect* pos, const int** order) const;
+
+  // Distance between neighbouring slots.
+  int spacing() const { return sp_; }
+
+ private:
+  int sp_;
+  int num_slots_;
+  // num_slots_ entries per offset from -sp_ to sp_.
+  std::vector<SDL_FRect> rects_;
+  std::vector<int> order_;
+};
+
+}  // namespace carousel
+
+#endif
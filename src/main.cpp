@@ -1,15 +1,40 @@
 #include <SDL2/SDL.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#endif
 
 #include <algorithm>
+#include <cerrno>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
+#include "asset_pack.h"
 #include "audio.h"
 #include "carousel.h"
+#include "file_watch.h"
+#include "image_loader.h"
+#include "input_trace.h"
 #include "res_path.h"
+#include "rom_readahead.h"
+#include "stats.h"
+
+#ifdef COUNT_ALLOCS
+#include "alloc_count.h"
+#endif
 
 int rendering_loop(carousel::Carousel&, SDL_Renderer*);
 
@@ -18,21 +43,80 @@ int rendering_loop(carousel::Carousel&, SDL_Renderer*);
 #define RC_SELECT 3
 #define RC_QUIT 4
 
-std::string current_genre = "root";
+// Assumed when the display does not report its refresh rate.
+#define DEFAULT_REFRESH 60
+// Longest frame the animation steps over, in seconds.  A stall (say, a burst
+// of texture uploads) resumes the spin rather than skipping cards.
+#define MAX_FRAME_TIME 0.1f
+// Without input devices to wait on, the idle carousel checks for input
+// every this many frames, about what it would while drawing.
+#define IDLE_POLL_FRAMES 2
+// A jump puts the carousel down this many cards short of its destination
+// and spins the rest of the way at FAST_FORWARD_RATE cards per second.
+#define FAST_FORWARD_CARDS 4
+#define FAST_FORWARD_RATE 24
+// Search closes after this long without typing, in ms.
+#define SEARCH_TIMEOUT_MS 4000
+
+// At startup and coming back from a game, the first frame waits up to this
+// long for the cards it shows, see WaitForVisibleCards().
+#define FIRST_FRAME_WAIT_MS 150
+
+int current_genre = ROOT_GENRE;
+// Card index the current genre opens at.
 int g_start_index = 0;
-int g_genre_index = 0;
+// Selected card index of each genre above the current one, root first.
+// Going back up returns to it.
+std::vector<int> g_parent_index;
+
+carousel::ImageLoader g_loader;
+// Images queued for loading, and how many the current genre asked for.
+std::set<int> g_pending_images;
+size_t g_load_total = 0;
+// Images of the current genre pinned around the selection.
+std::vector<int> g_window;
+// Images of the cards the genres above the current one show, pinned so
+// going back up needs no loading.
+std::vector<int> g_ancestor_images;
+// Pre-baked card images, and the requested ones waiting for an upload.
+carousel::AssetPack g_pack;
+std::deque<int> g_pack_queue;
+// Clock and input of the render loop, recorded or replayed on request.
+carousel::InputTrace g_trace;
+carousel::Stats g_stats;
+// Event pushed when SIGUSR1 asks for g_stats to be written out.
+Uint32 g_stats_event = (Uint32)-1;
+// Watches carousel.cfg and the images, pushing g_reload_event on changes.
+carousel::FileWatcher g_watcher;
+Uint32 g_reload_event = (Uint32)-1;
+
+carousel::RomReadahead g_readahead;
+
+Uint64 MicrosSince(Uint64 counter) {
+  return (SDL_GetPerformanceCounter() - counter) * 1000000 /
+         SDL_GetPerformanceFrequency();
+}
+
+// Resident mode keeps the background and other fixed images decoded, by
+// file, so taking the display back after a game only uploads them.
+bool g_keep_surfaces = false;
+std::map<std::string, SDL_Surface*> g_kept_surfaces;
 
 SDL_Texture* LoadTexture(SDL_Renderer* ren, std::string file) {
-  std::string imagePath = carousel::GetResourcePath() + file;
-  SDL_Surface* bmp = SDL_LoadBMP(imagePath.c_str());
+  std::map<std::string, SDL_Surface*>::iterator kept =
+      g_kept_surfaces.find(file);
+  SDL_Surface* bmp =
+      kept != g_kept_surfaces.end() ? kept->second : carousel::DecodeImage(file);
   if (bmp == NULL) {
-    std::cerr << "SDL_LoadBMP Error: " << file << "," << SDL_GetError()
-              << std::endl;
     return NULL;
   }
 
   SDL_Texture* tex = SDL_CreateTextureFromSurface(ren, bmp);
-  SDL_FreeSurface(bmp);
+  if (g_keep_surfaces) {
+    g_kept_surfaces[file] = bmp;
+  } else {
+    SDL_FreeSurface(bmp);
+  }
   if (tex == NULL) {
     std::cerr << "SDL_CreateTextureFromSurface Error: " << file << ","
               << SDL_GetError() << std::endl;
@@ -42,44 +126,58 @@ SDL_Texture* LoadTexture(SDL_Renderer* ren, std::string file) {
   return tex;
 }
 
-void RenderLoadingIndicator(carousel::Carousel& carousel, SDL_Renderer* ren,
-                            size_t loaded, size_t total) {
-  // Keep the loading screen independent of any additional image resources.
-  // This is important because the images being loaded are the resources that
-  // normally make up the carousel itself.
-  SDL_RenderClear(ren);
-  SDL_RenderCopy(ren, carousel.background_texture, NULL, NULL);
+SDL_Texture* CreatePlaceholderTexture(SDL_Renderer* ren) {
+  SDL_Surface* surface =
+      SDL_CreateRGBSurfaceWithFormat(0, 4, 4, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (surface == NULL) {
+    std::cerr << "SDL_CreateRGBSurfaceWithFormat Error: " << SDL_GetError()
+              << std::endl;
+    return NULL;
+  }
+  SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 48, 48, 48));
 
-  SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
-  SDL_SetRenderDrawColor(ren, 0, 0, 0, 190);
-  SDL_Rect overlay = {0, 0, carousel.width, carousel.height};
-  SDL_RenderFillRect(ren, &overlay);
-
-  const int center_x = carousel.width / 2;
-  const int center_y = carousel.height / 2;
-  const int spokes = 12;
-  const int inner_radius = std::max(18, carousel.height / 45);
-  const int outer_radius = inner_radius + std::max(16, carousel.height / 30);
-  const double pi = 3.14159265358979323846;
-  const int active_spoke =
-      (SDL_GetTicks() / 80) % spokes;
-
-  for (int i = 0; i < spokes; ++i) {
-    const double angle = (2.0 * pi * i) / spokes;
-    const int x1 = center_x + static_cast<int>(std::cos(angle) * inner_radius);
-    const int y1 = center_y + static_cast<int>(std::sin(angle) * inner_radius);
-    const int x2 = center_x + static_cast<int>(std::cos(angle) * outer_radius);
-    const int y2 = center_y + static_cast<int>(std::sin(angle) * outer_radius);
-    const int distance = (i - active_spoke + spokes) % spokes;
-    const Uint8 alpha = static_cast<Uint8>(255 - distance * 16);
-    SDL_SetRenderDrawColor(ren, 255, 255, 255, alpha);
-    SDL_RenderDrawLine(ren, x1, y1, x2, y2);
+  SDL_Texture* tex = SDL_CreateTextureFromSurface(ren, surface);
+  SDL_FreeSurface(surface);
+  if (tex == NULL) {
+    std::cerr << "SDL_CreateTextureFromSurface Error: placeholder,"
+              << SDL_GetError() << std::endl;
+  }
+  return tex;
+}
+
+// One box per character typed, along the top of the screen.  There is no
+// font to show the search itself; red boxes mean nothing matches.
+void RenderSearchIndicator(carousel::Carousel& carousel, SDL_Renderer* ren,
+                           size_t length, bool found) {
+  const int box = 16;
+  const int gap = 6;
+  const int width = std::max<int>(length, 1) * (box + gap) - gap;
+  SDL_Rect rect = {(carousel.width - width) / 2, box, box, box};
+  if (length == 0) {
+    // Just opened: an outline.
+    SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+    SDL_RenderDrawRect(ren, &rect);
+    return;
+  }
+  if (found) {
+    SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+  } else {
+    SDL_SetRenderDrawColor(ren, 220, 40, 40, 255);
   }
+  for (size_t i = 0; i < length; ++i) {
+    SDL_RenderFillRect(ren, &rect);
+    rect.x += box + gap;
+  }
+}
 
+void RenderLoadingIndicator(carousel::Carousel& carousel, SDL_Renderer* ren,
+                            size_t loaded, size_t total) {
+  // Drawn over the carousel while its images are still arriving.  Keep it
+  // independent of any image resources since those are what is loading.
   const int bar_width = std::max(160, carousel.width / 5);
   const int bar_height = 8;
-  const int bar_x = center_x - bar_width / 2;
-  const int bar_y = center_y + outer_radius + 24;
+  const int bar_x = (carousel.width - bar_width) / 2;
+  const int bar_y = carousel.height - bar_height * 4;
   SDL_SetRenderDrawColor(ren, 90, 90, 90, 255);
   SDL_Rect bar = {bar_x, bar_y, bar_width, bar_height};
   SDL_RenderFillRect(ren, &bar);
@@ -88,118 +186,934 @@ void RenderLoadingIndicator(carousel::Carousel& carousel, SDL_Renderer* ren,
     bar.w = static_cast<int>(bar_width * loaded / total);
     SDL_RenderFillRect(ren, &bar);
   }
+}
+
+// Make the loaders work on exactly the given files, in that order, plus any
+// other pinned image still on its way.  Images are added to the texture cache
+// as they arrive, see PumpImages().  Loads nothing wants any more are dropped
+// and anything already being decoded for them is discarded when it arrives.
+// Images in the asset pack skip the decoders entirely.
+void LoadInOrder(carousel::Carousel& carousel,
+                 const std::vector<int>& files) {
+  std::vector<int> wanted(files);
+  for (std::set<int>::iterator it = g_pending_images.begin();
+       it != g_pending_images.end(); ++it) {
+    if (carousel.images.Pinned(*it)) {
+      wanted.push_back(*it);
+    }
+  }
+
+  std::set<int> pending;
+  std::deque<int> pack_queue;
+  std::vector<std::string> decode;
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    const int image = wanted[i];
+    if (carousel.images.Contains(image) ||
+        pending.find(image) != pending.end()) {
+      continue;
+    }
+    pending.insert(image);
+    const std::string& filename = carousel.image_names.Get(image);
+    if (g_pack.Prefetch(filename)) {
+      pack_queue.push_back(image);
+    } else {
+      decode.push_back(filename);
+    }
+  }
 
-  SDL_RenderPresent(ren);
-  SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_NONE);
+  g_pending_images.swap(pending);
+  g_pack_queue.swap(pack_queue);
+  g_loader.Replace(decode);
 }
 
-bool LoadImages(SDL_Renderer* ren,
-                const std::vector<carousel::CarouselCard>& cards,
-                std::map<std::string, SDL_Texture*>* images,
-                carousel::Carousel* carousel = NULL) {
-  size_t loaded = 0;
-  for (size_t i = 0; i < cards.size(); ++i) {
-    const std::string& filename = cards[i].image_filename;
-    if (images->find(filename) != images->end()) {
-      ++loaded;
+// Upload decoded images to the renderer for up to budget ms.  Returns true if
+// any new texture became available.
+bool PumpImages(carousel::Carousel& carousel, SDL_Renderer* ren,
+                Uint32 budget) {
+  Uint32 start = SDL_GetTicks();
+  Uint64 start_counter = SDL_GetPerformanceCounter();
+  bool uploaded = false;
+  bool out_of_time = false;
+  std::set<int>::iterator it;
+
+  // Pack images go straight from the mapping to the atlas.
+  while (!g_pack_queue.empty()) {
+    it = g_pending_images.find(g_pack_queue.front());
+    g_pack_queue.pop_front();
+    if (it == g_pending_images.end()) {
+      // Cancelled.
+      continue;
+    }
+    if (carousel.images.Add(ren, *it,
+                            g_pack.Find(carousel.image_names.Get(*it)),
+                            g_pack.pitch())) {
+      uploaded = true;
+      g_stats.textures_loaded++;
+    }
+    g_pending_images.erase(it);
+
+    if (SDL_GetTicks() - start >= budget) {
+      out_of_time = true;
+      break;
+    }
+  }
+
+  std::string filename;
+  SDL_Surface* surface;
+  while (!out_of_time && g_loader.Collect(&filename, &surface)) {
+    it = g_pending_images.find(carousel.image_names.Find(filename));
+    if (it == g_pending_images.end()) {
+      // Cancelled while it was being decoded.
+      SDL_FreeSurface(surface);
+      continue;
+    }
+    const int image = *it;
+    g_pending_images.erase(it);
+
+    // A card that fails to decode keeps showing the placeholder.
+    if (surface == NULL) {
       continue;
     }
+    if (carousel.images.Add(ren, image, surface->pixels, surface->pitch)) {
+      uploaded = true;
+      g_stats.textures_loaded++;
+    }
+    SDL_FreeSurface(surface);
+
+    if (SDL_GetTicks() - start >= budget) {
+      break;
+    }
+  }
 
-    if (carousel != NULL) {
-      RenderLoadingIndicator(*carousel, ren, loaded, cards.size());
+  if (uploaded) {
+    g_stats.load_time.Record(MicrosSince(start_counter));
+  }
+  return uploaded;
+}
+
+// Whether SDL_WaitEventTimeout() sleeps until an event arrives.  Before SDL
+// 2.0.16, and on drivers without their own wait (kmsdrm among them), SDL
+// implements it by polling every millisecond, which wakes the CPU far more
+// often than our own frame timer.
+bool EventWaitBlocks() {
+  SDL_version version;
+  SDL_GetVersion(&version);
+  if (SDL_VERSIONNUM(version.major, version.minor, version.patch) <
+      SDL_VERSIONNUM(2, 0, 16)) {
+    return false;
+  }
+  const char* driver = SDL_GetCurrentVideoDriver();
+  if (driver == NULL) {
+    return false;
+  }
+  const char* blocking[] = {"x11", "wayland", "windows", "cocoa"};
+  for (size_t i = 0; i < sizeof(blocking) / sizeof(blocking[0]); ++i) {
+    if (strcmp(driver, blocking[i]) == 0) {
+      return true;
     }
-    SDL_Texture* texture = LoadTexture(ren, filename);
-    if (texture == NULL) {
-      for (std::map<std::string, SDL_Texture*>::iterator it = images->begin();
-           it != images->end(); ++it) {
-        SDL_DestroyTexture(it->second);
+  }
+  return false;
+}
+
+#ifdef __linux__
+// What an idle carousel waits on where EventWaitBlocks() is false: the read
+// end of g_wake_pipe, then the evdev devices.  Every reader of an evdev
+// device gets its own copy of its events, so reading here takes nothing
+// from SDL.
+std::vector<struct pollfd> g_input_polls;
+// The stats and file watcher threads write a byte here after pushing their
+// event.  They live until the process exits, so the pipe does too.
+int g_wake_pipe[2] = {-1, -1};
+#endif
+
+// The write end of a pipe that wakes WaitForInput(), or -1 if there is none.
+int OpenWakePipe() {
+#ifdef __linux__
+  if (g_wake_pipe[1] < 0) {
+    if (pipe2(g_wake_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+      std::cerr << "Could not create wake pipe: " << strerror(errno)
+                << std::endl;
+      return -1;
+    }
+    struct pollfd poll_fd;
+    poll_fd.fd = g_wake_pipe[0];
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    g_input_polls.insert(g_input_polls.begin(), poll_fd);
+  }
+  return g_wake_pipe[1];
+#else
+  return -1;
+#endif
+}
+
+void OpenInputDevices() {
+#ifdef __linux__
+  DIR* dir = opendir("/dev/input");
+  if (dir == NULL) {
+    return;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "event", 5) != 0) {
+      continue;
+    }
+    const std::string path = std::string("/dev/input/") + entry->d_name;
+    struct pollfd poll_fd;
+    poll_fd.fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    if (poll_fd.fd >= 0) {
+      g_input_polls.push_back(poll_fd);
+    }
+  }
+  closedir(dir);
+#endif
+}
+
+// Closes the input devices only; the wake pipe stays for the threads.
+void CloseInputDevices() {
+#ifdef __linux__
+  const size_t first = g_wake_pipe[0] >= 0 ? 1 : 0;
+  for (size_t i = first; i < g_input_polls.size(); ++i) {
+    close(g_input_polls[i].fd);
+  }
+  g_input_polls.resize(first);
+#endif
+}
+
+// Sleep for up to timeout ms where SDL cannot wait for events itself.  Stats
+// and reload requests end it through the wake pipe, and input does too when
+// the input devices could be opened.  Otherwise it sleeps IDLE_POLL_FRAMES
+// frames at most, so the first input after idle is seen about as quickly as
+// while drawing.
+void WaitForInput(int32_t timeout, uint32_t frame_delay) {
+#ifdef __linux__
+  const size_t devices = g_input_polls.size() - (g_wake_pipe[0] >= 0 ? 1 : 0);
+  if (devices == 0) {
+    timeout = std::min(timeout, (int32_t)(IDLE_POLL_FRAMES * frame_delay));
+  }
+  if (!g_input_polls.empty()) {
+    if (poll(&g_input_polls[0], g_input_polls.size(), timeout) > 0) {
+      // Drain our copy, or devices SDL ignores would keep waking us.
+      char buf[1024];
+      for (size_t i = 0; i < g_input_polls.size(); ++i) {
+        if ((g_input_polls[i].revents & POLLIN) != 0) {
+          while (read(g_input_polls[i].fd, buf, sizeof(buf)) > 0) {
+          }
+        }
       }
-      images->clear();
-      return false;
     }
-    (*images)[filename] = texture;
-    ++loaded;
+    return;
   }
-  return true;
+#endif
+  SDL_Delay(std::min(timeout, (int32_t)(IDLE_POLL_FRAMES * frame_delay)));
 }
 
-void DestroyImages(std::map<std::string, SDL_Texture*>* images) {
-  for (std::map<std::string, SDL_Texture*>::iterator it = images->begin();
-       it != images->end(); ++it) {
-    SDL_DestroyTexture(it->second);
+// Cards whose image has not arrived yet are shown as a placeholder.
+carousel::CardImage CurrentImage(carousel::Carousel& carousel, int image_id) {
+  const carousel::CardImage* image = carousel.images.Find(image_id);
+  if (image != NULL) {
+    return *image;
   }
-  images->clear();
+  carousel::CardImage placeholder;
+  placeholder.texture = carousel.placeholder_texture;
+  for (int i = 0; i < MIP_LEVELS; ++i) {
+    placeholder.level[i].x = 0;
+    placeholder.level[i].y = 0;
+    SDL_QueryTexture(placeholder.texture, NULL, NULL, &placeholder.level[i].w,
+                     &placeholder.level[i].h);
+  }
+  return placeholder;
 }
 
-bool LoadCurrentGenreImages(carousel::Carousel& carousel, SDL_Renderer* ren,
-                            bool show_loading = false) {
-  if (current_genre == "root") {
-    return LoadImages(ren, carousel.all_genres["root"].all_cards,
-                      &carousel.root_images,
-                      show_loading ? &carousel : NULL);
+// Point every carousel slot at the image of the card it currently shows.
+void FillCarouselImages(carousel::Carousel& carousel) {
+  const carousel::Genre& genre = carousel.genres[current_genre];
+  int card_index = carousel.low_index;
+  for (int i = 0; i < carousel.num_slots; i++) {
+    carousel.carousel_image[i] = CurrentImage(
+        carousel, carousel.cards.image[genre.first + card_index]);
+    card_index++;
+    if (card_index >= genre.count) {
+      card_index -= genre.count;
+    }
   }
-  if (!carousel.genre_images.empty()) {
-    return true;
+}
+
+// Images of the cards in the carousel slots, left to right.
+void VisibleImages(carousel::Carousel& carousel, std::vector<int>* images) {
+  const carousel::Genre& genre = carousel.genres[current_genre];
+  images->clear();
+  for (int i = 0; i < carousel.num_slots; i++) {
+    images->push_back(carousel.cards.image[
+        genre.first + (carousel.low_index + i) % genre.count]);
   }
-  return LoadImages(ren, carousel.all_genres[current_genre].all_cards,
-                    &carousel.genre_images,
-                    show_loading ? &carousel : NULL);
 }
 
-SDL_Texture* CurrentImage(carousel::Carousel& carousel, const std::string& file) {
-  const std::map<std::string, SDL_Texture*>& images =
-      current_genre == "root" ? carousel.root_images : carousel.genre_images;
-  std::map<std::string, SDL_Texture*>::const_iterator image = images.find(file);
-  return image == images.end() ? NULL : image->second;
+// Upload the visible cards as they arrive, for up to ms, so the next frame
+// shows them rather than placeholders.  Cards that cannot be loaded are
+// not waited for.  Everything else keeps loading behind the carousel.
+void WaitForVisibleCards(carousel::Carousel& carousel, SDL_Renderer* ren,
+                         Uint32 ms) {
+  std::vector<int> visible;
+  VisibleImages(carousel, &visible);
+  const Uint32 start = SDL_GetTicks();
+  for (;;) {
+    bool missing = false;
+    for (size_t i = 0; i < visible.size() && !missing; ++i) {
+      missing = !carousel.images.Contains(visible[i]) &&
+                g_pending_images.find(visible[i]) != g_pending_images.end();
+    }
+    const Uint32 elapsed = SDL_GetTicks() - start;
+    if (!missing || elapsed >= ms) {
+      break;
+    }
+    if (!PumpImages(carousel, ren, ms - elapsed)) {
+      SDL_Delay(1);
+    }
+  }
+  FillCarouselImages(carousel);
 }
 
 int get_selected_index(carousel::Carousel& carousel) {
   return std::abs(carousel.low_index + carousel.num_slots / 2) %
-                  carousel.all_genres[current_genre].all_cards.size();
+                  carousel.genres[current_genre].count;
 }
 
-carousel::CarouselCard& getCard(carousel::Carousel& carousel, int index) {
-  return carousel.all_genres[current_genre].all_cards[index];
+// Index in carousel.cards of the current genre's card index.
+int getCard(carousel::Carousel& carousel, int index) {
+  return carousel.Card(current_genre, index);
 }
 
+// Put card index of the current genre in the middle.
+void SetSelection(carousel::Carousel& carousel, int index) {
+  const int count = carousel.genres[current_genre].count;
+  carousel.low_index = index - carousel.num_slots / 2;
+  if (carousel.low_index < 0) {
+    carousel.low_index += count;
+  }
+  carousel.high_index = index + carousel.num_slots / 2;
+  if (carousel.high_index >= count) {
+    carousel.high_index -= count;
+  }
+}
+
+// Indexes of the current genre's cards that should be resident, nearest to
+// the selection first.  Cards coming up in the spin direction are wanted
+// further out than the ones left behind.  With no residency window the whole
+// genre is.
+void WindowCards(carousel::Carousel& carousel, int dir,
+                 std::vector<int>* order) {
+  const int n = carousel.genres[current_genre].count;
+  const int center = get_selected_index(carousel);
+  int before = n;
+  int after = n;
+  if (carousel.residency_window > 0) {
+    before = carousel.num_slots / 2 + carousel.residency_window;
+    after = before;
+    // Moving left brings in higher indexes, moving right lower ones.
+    if (dir == DIR_LEFT) {
+      after += carousel.residency_window;
+    } else if (dir == DIR_RIGHT) {
+      before += carousel.residency_window;
+    }
+  }
+
+  order->clear();
+  if (before + after + 1 >= n) {
+    // The window wraps onto itself, take every card once.
+    before = (n - 1) / 2;
+    after = n - 1 - before;
+  }
+  for (int d = 0; d <= std::max(before, after); ++d) {
+    if (d <= after) {
+      order->push_back((center + d) % n);
+    }
+    if (d > 0 && d <= before) {
+      order->push_back((center - d + n) % n);
+    }
+  }
+}
+
+// Pin the cards around the selection and load the ones that are missing.
+// Cards that drop out of the window stay cached until the texture budget
+// needs their space.
+void UpdateWindow(carousel::Carousel& carousel, int dir) {
+  std::vector<int> order;
+  WindowCards(carousel, dir, &order);
+
+  std::vector<int> window;
+  for (size_t i = 0; i < order.size(); ++i) {
+    window.push_back(carousel.cards.image[getCard(carousel, order[i])]);
+    carousel.images.Pin(window.back());
+  }
+  for (size_t i = 0; i < g_window.size(); ++i) {
+    carousel.images.Unpin(g_window[i]);
+  }
+  g_window.swap(window);
+
+  LoadInOrder(carousel, g_window);
+  if (g_pending_images.empty()) {
+    g_load_total = 0;
+  } else {
+    g_load_total = std::max(g_load_total, g_pending_images.size());
+  }
+}
+
+// Move the selection to card index of the current genre without spinning
+// through every card on the way.  The destination's window is pinned and
+// loaded, then the carousel is put down FAST_FORWARD_CARDS short of it to
+// spin the rest of the way, so the jump still reads as movement.  Returns
+// the direction to spin and sets speed to stop on index; DIR_NONE if the
+// selection is already there.
+int JumpTo(carousel::Carousel& carousel, int index, int* speed) {
+  const int n = carousel.genres[current_genre].count;
+  const int ahead = (index - get_selected_index(carousel) + n) % n;
+  if (index < 0 || ahead == 0) {
+    return DIR_NONE;
+  }
+  // Spinning left brings in higher indexes.
+  const int dir = ahead <= n - ahead ? DIR_LEFT : DIR_RIGHT;
+  const int lead = std::min(FAST_FORWARD_CARDS, std::min(ahead, n - ahead));
+
+  SetSelection(carousel, index);
+  g_load_total = 0;
+  UpdateWindow(carousel, DIR_NONE);
+  SetSelection(carousel, (index + dir * lead + n) % n);
+  FillCarouselImages(carousel);
+  g_stats.jumps++;
+  // The spin stops after speed + 1 cards.
+  *speed = lead - 1;
+  return dir;
+}
+
+// Leaving a genre keeps its images cached but lets them be evicted.
+void ReleaseGenreImages(carousel::Carousel& carousel) {
+  for (size_t i = 0; i < g_window.size(); ++i) {
+    carousel.images.Unpin(g_window[i]);
+  }
+  g_window.clear();
+  LoadInOrder(carousel, g_window);
+}
+
+// The screen saver only shows its own image.  Give back the card textures
+// screensaver_release allows and cancel their loads.
+void ShedImages(carousel::Carousel& carousel) {
+  if (carousel.screensaver_release == "none") {
+    return;
+  }
+  if (carousel.screensaver_release == "all") {
+    for (size_t i = 0; i < g_ancestor_images.size(); ++i) {
+      carousel.images.Unpin(g_ancestor_images[i]);
+    }
+  }
+  ReleaseGenreImages(carousel);
+  carousel.images.Trim(0);
+  // Slots must not keep evicted textures.
+  FillCarouselImages(carousel);
+}
+
+// The genres above genre, root first.
+void GenreAncestors(carousel::Carousel& carousel, int genre,
+                    std::vector<int>* ancestors) {
+  ancestors->clear();
+  for (int up = carousel.genres[genre].parent; up >= 0;
+       up = carousel.genres[up].parent) {
+    ancestors->insert(ancestors->begin(), up);
+  }
+}
+
+// Pin the cards each genre above the current one shows at its selection,
+// nearest genre first.  Any pinned before are let go.  Nothing else of
+// those genres stays pinned.
+void PinAncestorImages(carousel::Carousel& carousel) {
+  std::vector<int> ancestors;
+  GenreAncestors(carousel, current_genre, &ancestors);
+
+  std::vector<int> images;
+  for (size_t level = ancestors.size(); level-- > 0;) {
+    const carousel::Genre& genre = carousel.genres[ancestors[level]];
+    for (int d = -carousel.num_slots / 2; d <= carousel.num_slots / 2; ++d) {
+      const int index =
+          ((g_parent_index[level] + d) % genre.count + genre.count) %
+          genre.count;
+      images.push_back(carousel.cards.image[genre.first + index]);
+      carousel.images.Pin(images.back());
+    }
+  }
+  for (size_t i = 0; i < g_ancestor_images.size(); ++i) {
+    carousel.images.Unpin(g_ancestor_images[i]);
+  }
+  g_ancestor_images.swap(images);
+}
+
+// Load what the current genre's window and the genres above it are
+// missing, the window first.
+void LoadWindowAndAncestors(carousel::Carousel& carousel) {
+  std::vector<int> files(g_window);
+  files.insert(files.end(), g_ancestor_images.begin(),
+               g_ancestor_images.end());
+  LoadInOrder(carousel, files);
+  g_load_total = g_pending_images.size();
+}
+
+// Start loading the genre just entered.  The genres above it are pinned by
+// PinAncestorImages().
+void RequestCurrentGenreImages(carousel::Carousel& carousel) {
+  g_load_total = 0;
+  UpdateWindow(carousel, DIR_NONE);
+  LoadWindowAndAncestors(carousel);
+}
+
+// Where the carousel is now.
+void CurrentPath(carousel::Carousel& carousel, carousel::GenrePath* path) {
+  std::vector<int> ancestors;
+  GenreAncestors(carousel, current_genre, &ancestors);
+  path->clear();
+  for (size_t level = 0; level < ancestors.size(); ++level) {
+    path->push_back(std::make_pair(carousel.genre_names.Get(ancestors[level]),
+                                   g_parent_index[level]));
+  }
+  path->push_back(std::make_pair(carousel.genre_names.Get(current_genre),
+                                 get_selected_index(carousel)));
+}
+
+// Go to path, or as far down it as the config still has, without loading
+// anything.  Indexes past the end of a genre are taken as its last card.
+void OpenPath(carousel::Carousel& carousel, const carousel::GenrePath& path) {
+  current_genre = ROOT_GENRE;
+  g_start_index = 0;
+  g_parent_index.clear();
+  for (size_t level = 0; level < path.size(); ++level) {
+    const int genre = carousel.genre_names.Find(path[level].first);
+    if (level == 0 ? genre != ROOT_GENRE
+                   : genre < 0 || carousel.genres[genre].parent != current_genre) {
+      break;
+    }
+    if (level > 0) {
+      g_parent_index.push_back(g_start_index);
+      current_genre = genre;
+    }
+    g_start_index = std::max(
+        0, std::min(path[level].second, carousel.genres[genre].count - 1));
+  }
+}
+
+// Undo ShedImages().  The visible cards are queued first so the carousel is
+// usable straight away; placeholders stand in until they arrive.
+void RestoreImages(carousel::Carousel& carousel) {
+  if (carousel.screensaver_release == "none") {
+    return;
+  }
+  g_load_total = 0;
+  UpdateWindow(carousel, DIR_NONE);
+  if (carousel.screensaver_release == "all") {
+    for (size_t i = 0; i < g_ancestor_images.size(); ++i) {
+      carousel.images.Pin(g_ancestor_images[i]);
+    }
+    LoadWindowAndAncestors(carousel);
+  }
+  FillCarouselImages(carousel);
+}
+
+// Take what the file watcher saw change.  Images whose file changed are
+// dropped and loaded again if they are still wanted; a changed config
+// replaces the cards, keeping the selection on the same genre and card when
+// they are still there.  Returns true if the cards were replaced.
+bool ApplyChanges(carousel::Carousel& carousel) {
+  bool config_changed;
+  std::set<std::string> files;
+  g_watcher.TakeChanges(&config_changed, &files);
+
+  for (std::set<std::string>::iterator it = files.begin(); it != files.end();
+       ++it) {
+    g_pack.Recheck(*it);
+    int image = carousel.image_names.Find(*it);
+    if (image >= 0) {
+      carousel.images.Remove(image);
+    }
+  }
+
+  bool reloaded = false;
+  if (config_changed) {
+    carousel::GenrePath path;
+    CurrentPath(carousel, &path);
+    const int card = getCard(carousel, path.back().second);
+    const int image = carousel.cards.image[card];
+    const std::string rom = carousel.cards.rom[card] < 0
+                                ? ""
+                                : carousel.roms.Get(carousel.cards.rom[card]);
+
+    if (carousel.ReloadCards()) {
+      reloaded = true;
+      std::cerr << "Reloaded " << CONFIG_FILE << std::endl;
+      OpenPath(carousel, path);
+
+      // Image ids survive a reload, rom ids do not.
+      if (carousel.genre_names.Get(current_genre) == path.back().first) {
+        const carousel::Genre& genre = carousel.genres[current_genre];
+        for (int i = 0; i < genre.count; ++i) {
+          const int rom_id = carousel.cards.rom[genre.first + i];
+          if (carousel.cards.image[genre.first + i] == image &&
+              (rom_id < 0 ? "" : carousel.roms.Get(rom_id)) == rom) {
+            g_start_index = i;
+            break;
+          }
+        }
+      }
+      SetSelection(carousel, g_start_index);
+      PinAncestorImages(carousel);
+    }
+  }
+
+  UpdateWindow(carousel, DIR_NONE);
+  LoadWindowAndAncestors(carousel);
+  FillCarouselImages(carousel);
+  return reloaded;
+}
+
+// Background and cards at the positions last set by SetCarouselPositions().
+void DrawScene(carousel::Carousel& carousel, SDL_Renderer* ren) {
+  SDL_RenderCopy(ren, carousel.background_texture, NULL, NULL);
+  for (int i = 0; i < carousel.num_slots; i++) {
+    // Cards share a few atlas textures so consecutive copies batch
+    // together.  Smaller slots draw from a smaller mip level.
+    const int slot = carousel.draw_order[i];
+    const carousel::CardImage& image = carousel.carousel_image[slot];
+    const SDL_FRect& pos = carousel.carousel_pos[slot];
+    int level = carousel::PickMipLevel(image.level, (int)pos.w);
+    SDL_RenderCopyF(ren, image.texture, &image.level[level], &pos);
+  }
+}
+
+// Render target for the carousel at rest, see rendering_loop().  NULL if
+// the renderer cannot draw to textures; the scene is then drawn every frame.
+SDL_Texture* CreateSceneTexture(carousel::Carousel& carousel,
+                                SDL_Renderer* ren) {
+  if (!SDL_RenderTargetSupported(ren)) {
+    return NULL;
+  }
+  SDL_Texture* scene =
+      SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888,
+                        SDL_TEXTUREACCESS_TARGET, carousel.width,
+                        carousel.height);
+  if (scene == NULL) {
+    std::cerr << "Could not create scene texture: " << SDL_GetError()
+              << std::endl;
+    return NULL;
+  }
+  // Nothing is under it to blend with.
+  SDL_SetTextureBlendMode(scene, SDL_BLENDMODE_NONE);
+  return scene;
+}
+
+// The full screen window and its renderer.  Replays run unthrottled.  The
+// software renderer covers machines without a GPU, or SDL's dummy and
+// offscreen video drivers.  Returns false, after reporting it, with neither
+// made.
+bool OpenDisplay(carousel::Carousel& carousel, SDL_Window** win,
+                 SDL_Renderer** ren) {
+  *win = SDL_CreateWindow("Arcade Menu", 0, 0, carousel.width,
+                          carousel.height, SDL_WINDOW_SHOWN);
+  if (*win == NULL) {
+    std::cerr << "SDL_CreateWindow Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+
+  Uint32 render_flags = SDL_RENDERER_ACCELERATED;
+  if (!g_trace.replaying()) {
+    render_flags |= SDL_RENDERER_PRESENTVSYNC;
+  }
+  *ren = SDL_CreateRenderer(*win, -1, render_flags);
+  if (*ren == NULL) {
+    std::cerr << "No accelerated renderer, using software: " << SDL_GetError()
+              << std::endl;
+    *ren = SDL_CreateRenderer(*win, -1, SDL_RENDERER_SOFTWARE);
+  }
+  if (*ren == NULL) {
+    std::cerr << "SDL_CreateRenderer Error: " << SDL_GetError() << std::endl;
+    SDL_DestroyWindow(*win);
+    *win = NULL;
+    return false;
+  }
+  return true;
+}
+
+void DestroyScreenTextures(carousel::Carousel& carousel) {
+  SDL_Texture** textures[] = {
+      &carousel.background_texture, &carousel.screensaver_texture,
+      &carousel.volume_texture,     &carousel.patience_texture,
+      &carousel.placeholder_texture, &carousel.scene_texture};
+  for (size_t i = 0; i < sizeof(textures) / sizeof(textures[0]); ++i) {
+    if (*textures[i] != NULL) {
+      SDL_DestroyTexture(*textures[i]);
+      *textures[i] = NULL;
+    }
+  }
+}
+
+// Everything drawn besides the cards.  Returns false if any of it could not
+// be made, with none of it left.  The scene texture is optional.
+bool CreateScreenTextures(carousel::Carousel& carousel, SDL_Renderer* ren) {
+  carousel.background_texture = LoadTexture(ren, "background.bmp");
+  carousel.screensaver_texture = LoadTexture(ren, "scr_saver.bmp");
+  carousel.volume_texture = LoadTexture(ren, "volume.bmp");
+  carousel.placeholder_texture = CreatePlaceholderTexture(ren);
+  if (carousel.background_texture == NULL ||
+      carousel.screensaver_texture == NULL ||
+      carousel.volume_texture == NULL ||
+      carousel.placeholder_texture == NULL) {
+    DestroyScreenTextures(carousel);
+    return false;
+  }
+  carousel.scene_texture = CreateSceneTexture(carousel, ren);
+  return true;
+}
+
+// The command that runs the selected card's game.  Empty for genre and back
+// cards, which have no emulator.
+std::string LaunchCommand(carousel::Carousel& carousel) {
+  const int card = getCard(carousel, get_selected_index(carousel));
+  const int emu = carousel.cards.emu[card];
+  const int rom = carousel.cards.rom[card];
+  char cmd[512] = "";
+  if (emu >= 0) {
+    snprintf(cmd, 512, carousel.emulators[emu].cmd.c_str(),
+             carousel.roms.Get(rom).c_str());
+  }
+  return cmd;
+}
+
+// Resident mode: give the screen and the sound device to a game.  Textures
+// go with the renderer.  Card pins are kept, so the same cards come back.
+void ReleaseDisplay(carousel::Carousel& carousel, SDL_Window** win,
+                    SDL_Renderer** ren) {
+  DestroyScreenTextures(carousel);
+  carousel.images.Clear();
+  g_pending_images.clear();
+  g_pack_queue.clear();
+  carousel::DestroySound(carousel);
+  SDL_DestroyRenderer(*ren);
+  SDL_DestroyWindow(*win);
+  *ren = NULL;
+  *win = NULL;
+  // kmsdrm only gives up the display with the video subsystem.
+  SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+// Undo ReleaseDisplay().  Returns false, after reporting it, if the menu
+// cannot be shown again.
+bool TakeDisplay(carousel::Carousel& carousel, SDL_Window** win,
+                 SDL_Renderer** ren) {
+  if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+    std::cerr << "SDL_InitSubSystem Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+  if (!OpenDisplay(carousel, win, ren) ||
+      !CreateScreenTextures(carousel, *ren)) {
+    return false;
+  }
+  SDL_ShowCursor(0);
+  carousel::InitSound(carousel);
+  // Input while the game ran was the game's, and the old window is gone.
+  // Stats and reload events are kept.
+  SDL_FlushEvents(SDL_WINDOWEVENT, SDL_RENDER_DEVICE_RESET);
+  return true;
+}
+
+// Resident mode: run cmd through the shell, as carousel.sh would, with the
+// display handed over, and take it back once the game exits.  The cards on
+// screen are decoded again while the game runs, so coming back only uploads
+// them.  Returns false if the display could not be taken back.
+bool RunGame(carousel::Carousel& carousel, const std::string& cmd,
+             SDL_Window** win, SDL_Renderer** ren) {
+  ReleaseDisplay(carousel, win, ren);
+
+  std::vector<int> visible;
+  VisibleImages(carousel, &visible);
+  LoadInOrder(carousel, visible);
+  // The game reads its own ROM now.
+  g_readahead.Cancel();
+
+  // Set up before fork(); the child may only make async-signal-safe calls.
+  // SIGUSR1 is blocked for the stats thread, see BlockDumpSignal(), and the
+  // game must not inherit that.
+  const char* command = cmd.c_str();
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  g_stats.launches++;
+  const pid_t pid = fork();
+  if (pid == 0) {
+    sigprocmask(SIG_UNBLOCK, &signals, NULL);
+    execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+    _exit(127);
+  }
+  if (pid < 0) {
+    std::cerr << "Could not run " << cmd << ": " << strerror(errno)
+              << std::endl;
+  } else {
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+  }
+
+  const Uint64 start = SDL_GetPerformanceCounter();
+  if (!TakeDisplay(carousel, win, ren)) {
+    return false;
+  }
+  WaitForVisibleCards(carousel, *ren, FIRST_FRAME_WAIT_MS);
+  g_stats.return_time.Record(MicrosSince(start));
+  return true;
+}
+
+// What was on screen when the carousel last stopped: the card size and the
+// image of each visible card, left to right.  Decoding them starts before
+// anything else, see main().
+struct WarmStart {
+  WarmStart() : card_w(0), card_h(0) {}
+
+  int card_w;
+  int card_h;
+  std::vector<std::string> images;
+};
+
+// One line per genre from root down to the open one: its name and the
+// index of its selected card.  Then a blank line, the card size and the
+// image of each visible card, one per line.
 void saveSelection(carousel::Carousel& carousel) {
-  int selected = get_selected_index(carousel);
+  // A replay must not change where the next real run starts.
+  if (g_trace.replaying()) {
+    return;
+  }
+  carousel::GenrePath path;
+  CurrentPath(carousel, &path);
+  int card_w, card_h;
+  carousel.CardSize(&card_w, &card_h);
+  std::vector<int> visible;
+  VisibleImages(carousel, &visible);
 
   std::ofstream file;
   file.open("/tmp/carousel.idx", std::ofstream::out);
   if (!file.fail()) {
-    file << current_genre;
-    file << std::endl;
-    file << g_genre_index;
-    file << std::endl;
-    file << selected;
-    file << std::endl;
+    for (size_t i = 0; i < path.size(); ++i) {
+      file << path[i].first << " " << path[i].second << std::endl;
+    }
+    file << std::endl << card_w << " " << card_h << std::endl;
+    for (size_t i = 0; i < visible.size(); ++i) {
+      file << carousel.image_names.Get(visible[i]) << std::endl;
+    }
   }
   file.close();
 }
 
-void loadSelection(int *start_index, int *genre_index) {
-  int index;
-  int index2;
+void loadSelection(carousel::GenrePath* path, WarmStart* warm) {
+  std::vector<std::string> lines;
   std::ifstream file;
   file.open("/tmp/carousel.idx");
-  if (!file.fail()) {
-    file >> current_genre;
-    file >> index;
-    file >> index2;
-    *genre_index = index;
-    *start_index = index2;
+  std::string line;
+  while (std::getline(file, line) && !line.empty()) {
+    lines.push_back(line);
+  }
+  if (std::getline(file, line) &&
+      sscanf(line.c_str(), "%d %d", &warm->card_w, &warm->card_h) == 2 &&
+      warm->card_w > 0 && warm->card_h > 0) {
+    while (std::getline(file, line)) {
+      if (!line.empty()) {
+        warm->images.push_back(line);
+      }
+    }
+  } else {
+    warm->card_w = 0;
+    warm->card_h = 0;
   }
   file.close();
+
+  path->clear();
+  if (lines.size() == 3 && lines[0].find(' ') == std::string::npos) {
+    // Written before genres nested: open genre, root index, start index.
+    if (lines[0] == "root") {
+      path->push_back(std::make_pair(lines[0], atoi(lines[2].c_str())));
+    } else {
+      path->push_back(std::make_pair(std::string("root"),
+                                     atoi(lines[1].c_str())));
+      path->push_back(std::make_pair(lines[0], atoi(lines[2].c_str())));
+    }
+    return;
+  }
+  for (size_t i = 0; i < lines.size(); ++i) {
+    // Genre names may have spaces; the index is after the last one.
+    const size_t space = lines[i].rfind(' ');
+    if (space != std::string::npos) {
+      path->push_back(std::make_pair(lines[i].substr(0, space),
+                                     atoi(lines[i].c_str() + space + 1)));
+    }
+  }
 }
 
-int main(int, char**) {
+int main(int argc, char** argv) {
   int rc;
+  const char* record_path = NULL;
+  const char* replay_path = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--record file | --replay file]"
+                << std::endl;
+      return 1;
+    }
+  }
+  // Before any thread exists, so SIGUSR1 only reaches the stats thread.
+  carousel::BlockDumpSignal();
+
+  if ((record_path != NULL && !g_trace.StartRecording(record_path)) ||
+      (replay_path != NULL && !g_trace.StartReplay(replay_path))) {
+    return 1;
+  }
+
+  // Start on the cards that were showing at the last exit while the config
+  // is read and the display comes up.  They are only a guess until the
+  // config says what the saved place shows now; anything no longer wanted
+  // is dropped then.  Replays start where their trace says.
+  carousel::GenrePath start;
+  WarmStart warm;
+  loadSelection(&start, &warm);
+  if (replay_path == NULL && warm.card_w > 0 &&
+      g_loader.Start(warm.card_w, warm.card_h)) {
+    g_pack.Open(carousel::GetResourcePath() + ASSET_PACK_FILE, warm.card_w,
+                warm.card_h);
+    std::vector<std::string> decode;
+    for (size_t i = 0; i < warm.images.size(); ++i) {
+      if (!g_pack.Prefetch(warm.images[i])) {
+        decode.push_back(warm.images[i]);
+      }
+    }
+    g_loader.Replace(decode);
+  } else {
+    warm.card_w = 0;
+  }
+
   carousel::Carousel carousel;
   if (!carousel.ParseConfig()) {
     std::cerr << "Could not parse config file" << std::endl;
     return 1;
   }
+  if (g_trace.replaying()) {
+    // Replays are for timing and may run where there is no sound device.
+    // They end on a selection rather than run the game, so reading its ROM
+    // would only compete with the images for the disk.
+    carousel.click = false;
+    carousel.resident = false;
+    carousel.readahead_dwell = 0;
+  }
+  g_keep_surfaces = carousel.resident;
+  if (carousel.readahead_dwell > 0) {
+    g_readahead.Start();
+  }
 
   int sdl_init_mode = SDL_INIT_VIDEO;
   if (carousel.click) {
@@ -210,6 +1124,31 @@ int main(int, char**) {
     std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
     return 1;
   }
+  // Resident mode shuts video down while a game runs.  Initialized on its
+  // own, the event queue outlives it, so stats and reload events sent in
+  // the meantime are still there afterwards.
+  if (carousel.resident && SDL_InitSubSystem(SDL_INIT_EVENTS) != 0) {
+    std::cerr << "SDL_InitSubSystem Error: " << SDL_GetError() << std::endl;
+    SDL_Quit();
+    return 1;
+  }
+
+  // Replays never sleep.
+  const bool idle_polls = !g_trace.replaying() && !EventWaitBlocks();
+  const int wake_fd = idle_polls ? OpenWakePipe() : -1;
+
+  g_stats_event = SDL_RegisterEvents(1);
+  if (g_stats_event != (Uint32)-1) {
+    carousel::StartDumpSignalThread(g_stats_event, wake_fd);
+  }
+  // Replays must see the same cards throughout.
+  if (carousel.hot_reload && !g_trace.replaying()) {
+    g_reload_event = SDL_RegisterEvents(1);
+    if (g_reload_event != (Uint32)-1) {
+      g_watcher.Start(CONFIG_FILE, carousel::GetResourcePath(),
+                      g_reload_event, wake_fd);
+    }
+  }
 
   SDL_DisplayMode current;
   for (int i = 0; i < SDL_GetNumVideoDisplays(); ++i) {
@@ -232,6 +1171,10 @@ int main(int, char**) {
     return 1;
   }
 
+  if (!carousel.BuildLayout()) {
+    return 1;
+  }
+
   carousel::InitSound(carousel);
 
 #ifdef ALSA_FOUND
@@ -259,10 +1202,9 @@ int main(int, char**) {
   }
 #endif
 
-  SDL_Window* win = SDL_CreateWindow("Arcade Menu", 0, 0, carousel.width,
-                                     carousel.height, SDL_WINDOW_SHOWN);
-  if (win == NULL) {
-    std::cerr << "SDL_CreateWindow Error: " << SDL_GetError() << std::endl;
+  SDL_Window* win = NULL;
+  SDL_Renderer* ren = NULL;
+  if (!OpenDisplay(carousel, &win, &ren)) {
 #ifdef ALSA_FOUND
     if (carousel.mixer_opened) {
       snd_mixer_close(carousel.handle);
@@ -273,23 +1215,7 @@ int main(int, char**) {
     return 1;
   }
 
-  SDL_Renderer* ren = SDL_CreateRenderer(
-      win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-  if (ren == NULL) {
-    std::cerr << "SDL_CreateRenderer Error: " << SDL_GetError() << std::endl;
-#ifdef ALSA_FOUND
-    if (carousel.mixer_opened) {
-      snd_mixer_close(carousel.handle);
-    }
-#endif
-    carousel::DestroySound(carousel);
-    SDL_DestroyWindow(win);
-    SDL_Quit();
-    return 1;
-  }
-
-  carousel.background_texture = LoadTexture(ren, "background.bmp");
-  if (carousel.background_texture == NULL) {
+  if (!CreateScreenTextures(carousel, ren)) {
 #ifdef ALSA_FOUND
     if (carousel.mixer_opened) {
       snd_mixer_close(carousel.handle);
@@ -302,14 +1228,21 @@ int main(int, char**) {
     return 1;
   }
 
-  carousel.screensaver_texture = LoadTexture(ren, "scr_saver.bmp");
-  if (carousel.screensaver_texture == NULL) {
+  // Cards are decoded straight to the size they are shown at.  The screen
+  // or layout may have changed since the warm start guessed it.
+  int card_w, card_h;
+  carousel.CardSize(&card_w, &card_h);
+  const bool warm_sized = warm.card_w == card_w && warm.card_h == card_h;
+  if (!warm_sized) {
+    g_loader.Stop();
+  }
+  if (!g_loader.Start(card_w, card_h)) {
 #ifdef ALSA_FOUND
     if (carousel.mixer_opened) {
       snd_mixer_close(carousel.handle);
     }
 #endif
-    SDL_DestroyTexture(carousel.background_texture);
+    DestroyScreenTextures(carousel);
     carousel::DestroySound(carousel);
     SDL_DestroyRenderer(ren);
     SDL_DestroyWindow(win);
@@ -317,67 +1250,42 @@ int main(int, char**) {
     return 1;
   }
 
-  carousel.volume_texture = LoadTexture(ren, "volume.bmp");
-  if (carousel.volume_texture == NULL) {
-#ifdef ALSA_FOUND
-    if (carousel.mixer_opened) {
-      snd_mixer_close(carousel.handle);
-    }
-#endif
-    SDL_DestroyTexture(carousel.screensaver_texture);
-    SDL_DestroyTexture(carousel.background_texture);
-    carousel::DestroySound(carousel);
-    SDL_DestroyRenderer(ren);
-    SDL_DestroyWindow(win);
-    SDL_Quit();
-    return 1;
+  // Without a usable pack every image is decoded from its loose file.
+  if (!warm_sized) {
+    g_pack.Open(carousel::GetResourcePath() + ASSET_PACK_FILE, card_w,
+                card_h);
   }
 
   SDL_ShowCursor(0);
-
-  loadSelection(&g_start_index, &g_genre_index);
-
-  // The root genre is the genre-selection screen, so its images stay loaded.
-  // A saved selection may start inside a child genre; load only that genre too.
-  if (!LoadImages(ren, carousel.all_genres["root"].all_cards,
-                  &carousel.root_images, &carousel) ||
-      !LoadCurrentGenreImages(carousel, ren, true)) {
-    DestroyImages(&carousel.genre_images);
-    DestroyImages(&carousel.root_images);
-    SDL_DestroyTexture(carousel.volume_texture);
-    SDL_DestroyTexture(carousel.screensaver_texture);
-    SDL_DestroyTexture(carousel.background_texture);
-    SDL_DestroyRenderer(ren);
-    SDL_DestroyWindow(win);
-    SDL_Quit();
-    return 1;
+  if (idle_polls) {
+    OpenInputDevices();
   }
 
-  while (1) {
+  g_trace.ReplayStart(&start);
+  // A saved genre the config has since lost opens its nearest ancestor.
+  OpenPath(carousel, start);
+  g_trace.RecordStart(start);
 
-    if (!LoadCurrentGenreImages(carousel, ren, true)) {
-      break;
-    }
+  // A saved selection may start deep in the genre tree.  Only the genre
+  // opened and what its ancestors show at their selections is loaded.
+  // Images are decoded in the background while the carousel is already up.
+  carousel.images.SetCardSize(card_w, card_h);
+  PinAncestorImages(carousel);
+  // Replays wait for every image anyway.
+  bool first_frame = !g_trace.replaying();
 
-    carousel.low_index = g_start_index - carousel.num_slots / 2;
-    if (carousel.low_index < 0) {
-      carousel.low_index += carousel.all_genres[current_genre].all_cards.size();
-    }
-    carousel.high_index = g_start_index + carousel.num_slots / 2;
-    if (carousel.high_index >= (int)carousel.all_genres[current_genre].all_cards.size()) {
-      carousel.high_index -= (int)carousel.all_genres[current_genre].all_cards.size();
-    }
+  while (1) {
+
+    SetSelection(carousel, g_start_index);
 
     // Load the first carousel cards.
-    int card_index = carousel.low_index;
-    for (int i = 0; i < carousel.num_slots; i++) {
-      carousel.carousel_image[i] = CurrentImage(
-          carousel,
-          carousel.all_genres[current_genre].all_cards.at(card_index).image_filename);
-      card_index++;
-      if (card_index >= (int)carousel.all_genres[current_genre].all_cards.size()) {
-        card_index -= carousel.all_genres[current_genre].all_cards.size();
-      }
+    RequestCurrentGenreImages(carousel);
+    FillCarouselImages(carousel);
+    // The first frame shows the cards the warm start has had decoding
+    // since the process began.
+    if (first_frame) {
+      WaitForVisibleCards(carousel, ren, FIRST_FRAME_WAIT_MS);
+      first_frame = false;
     }
 
     rc = rendering_loop(carousel, ren);
@@ -385,26 +1293,33 @@ int main(int, char**) {
     saveSelection(carousel);
 
     for (int i = 0; i < carousel.num_slots; i++) {
-      carousel.carousel_image[i] = NULL;
+      carousel.carousel_image[i].texture = NULL;
     }
 
     if (rc == RC_INDIR) {
        int selected = get_selected_index(carousel);
-       g_genre_index = selected;
-       current_genre = getCard(carousel, selected).genre;
-       DestroyImages(&carousel.genre_images);
-    } else if (rc == RC_UPDIR) {
-       // Don't support nesting yet
-       current_genre = "root";
-       DestroyImages(&carousel.genre_images);
-       g_start_index = g_genre_index;
+       g_parent_index.push_back(selected);
+       current_genre = carousel.cards.genre[getCard(carousel, selected)];
+       g_start_index = 0;
+       // Pinned before the rest of the genre left is let go, so loads of
+       // the cards it shows are not dropped.
+       PinAncestorImages(carousel);
+       ReleaseGenreImages(carousel);
+    } else if (rc == RC_UPDIR ||
+               (rc == RC_QUIT && current_genre != ROOT_GENRE)) {
+       ReleaseGenreImages(carousel);
+       current_genre = carousel.genres[current_genre].parent;
+       g_start_index = g_parent_index.back();
+       g_parent_index.pop_back();
+       PinAncestorImages(carousel);
     } else if (rc == RC_QUIT) {
-       if (current_genre == "root")
-          break;
-       else {
-          current_genre = "root";
-          DestroyImages(&carousel.genre_images);
-          g_start_index = g_genre_index;
+       break;
+    } else if (carousel.resident) {
+       // SELECTED, and run from here.  The menu comes back on the same card.
+       g_start_index = get_selected_index(carousel);
+       if (!RunGame(carousel, LaunchCommand(carousel), &win, &ren)) {
+         rc = RC_QUIT;
+         break;
        }
     } else {
        // SELECTED
@@ -414,13 +1329,21 @@ int main(int, char**) {
 
   }
 
-  if (carousel.patience_texture != NULL) {
-    SDL_DestroyTexture(carousel.patience_texture);
-  }
+  g_trace.PrintSummary();
+  g_stats.Dump(carousel.stats_file);
+
   // Cleanup
-  SDL_DestroyTexture(carousel.background_texture);
-  DestroyImages(&carousel.genre_images);
-  DestroyImages(&carousel.root_images);
+  g_readahead.Stop();
+  CloseInputDevices();
+  g_loader.Stop();
+  g_pack.Close();
+  DestroyScreenTextures(carousel);
+  carousel.images.Clear();
+  for (std::map<std::string, SDL_Surface*>::iterator it =
+           g_kept_surfaces.begin();
+       it != g_kept_surfaces.end(); ++it) {
+    SDL_FreeSurface(it->second);
+  }
 
 
 #ifdef ALSA_FOUND
@@ -432,16 +1355,22 @@ int main(int, char**) {
   SDL_DestroyRenderer(ren);
   SDL_DestroyWindow(win);
   SDL_Quit();
+#ifdef COUNT_ALLOCS
+  std::cerr << "Render loop allocations after warm up: "
+            << carousel::CountedAllocs() << std::endl;
+  return carousel::CountedAllocs() == 0 ? 0 : 1;
+#endif
   return rc == RC_SELECT ? 0 : 1;
 }
 
 bool move_left(carousel::Carousel& carousel) {
+  const int count = carousel.genres[current_genre].count;
   carousel.low_index++;
-  if (carousel.low_index >= (int)carousel.all_genres[current_genre].all_cards.size()) {
+  if (carousel.low_index >= count) {
     carousel.low_index = 0;
   }
   carousel.high_index++;
-  if (carousel.high_index >= (int)carousel.all_genres[current_genre].all_cards.size()) {
+  if (carousel.high_index >= count) {
     carousel.high_index = 0;
   }
 
@@ -449,68 +1378,64 @@ bool move_left(carousel::Carousel& carousel) {
     carousel.carousel_image[i] = carousel.carousel_image[i + 1];
   }
   carousel.carousel_image[carousel.num_slots - 1] = CurrentImage(
-      carousel,
-      carousel.all_genres[current_genre].all_cards.at(carousel.high_index).image_filename);
-  if (carousel.carousel_image[carousel.num_slots - 1] == NULL) {
+      carousel, carousel.cards.image[getCard(carousel, carousel.high_index)]);
+  if (carousel.carousel_image[carousel.num_slots - 1].texture == NULL) {
     return true;
   }
   return false;
 }
 
 bool move_right(carousel::Carousel& carousel) {
+  const int count = carousel.genres[current_genre].count;
   carousel.low_index--;
   if (carousel.low_index < 0) {
-    carousel.low_index = carousel.all_genres[current_genre].all_cards.size() - 1;
+    carousel.low_index = count - 1;
   }
   carousel.high_index--;
   if (carousel.high_index < 0) {
-    carousel.high_index = carousel.all_genres[current_genre].all_cards.size() - 1;
+    carousel.high_index = count - 1;
   }
 
   for (int i = carousel.num_slots - 1; i >= 1; i--) {
     carousel.carousel_image[i] = carousel.carousel_image[i - 1];
   }
   carousel.carousel_image[0] = CurrentImage(
-      carousel,
-      carousel.all_genres[current_genre].all_cards.at(carousel.low_index).image_filename);
-  if (carousel.carousel_image[0] == NULL) {
+      carousel, carousel.cards.image[getCard(carousel, carousel.low_index)]);
+  if (carousel.carousel_image[0].texture == NULL) {
     return true;
   }
   return false;
 }
 
 
+// Keys that edit an open search rather than doing what they usually do.
+bool IsSearchKey(SDL_Keycode key) {
+  return (key >= SDLK_a && key <= SDLK_z) || (key >= SDLK_0 && key <= SDLK_9) ||
+         key == SDLK_BACKSPACE || key == SDLK_RETURN || key == SDLK_ESCAPE;
+}
+
 bool patience_needed(carousel::Carousel& carousel) {
   int selected = get_selected_index(carousel);
-  return carousel.all_genres[current_genre].all_cards[selected].patience;
+  return (carousel.cards.flags[getCard(carousel, selected)] &
+          CARD_PATIENCE) != 0;
 }
 
 
 bool select_game(carousel::Carousel& carousel, bool screensaver) {
   // Don't process select if we are waking up from saver
   if (!screensaver) {
-    int selected = get_selected_index(carousel);
-
-    //std::ofstream last_index_file;
-    //last_index_file.open("/tmp/carousel.idx", std::ofstream::out);
-    //if (!last_index_file.fail()) {
-    //  last_index_file << selected;
-    //}
-    //last_index_file.close();
-
-    carousel::Emulator emu =
-        carousel.all_emulators[carousel.all_genres[current_genre].all_cards[selected].emu];
-    char cmd[512];
-    snprintf(cmd, 512, emu.cmd.c_str(),
-            carousel.all_genres[current_genre].all_cards[selected].rom.c_str());
-    std::cout << cmd << std::endl;
+    // Genre and back cards have no emulator and print an empty line.
+    // Resident mode runs the game itself, see RunGame().
+    if (!carousel.resident) {
+      std::cout << LaunchCommand(carousel) << std::endl;
+    }
     return true;
   }
   return false;
 }
 
 int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
-  int spin_pos = 0;
+  float spin_pos = 0;
   int dir = DIR_NONE;
   int speed = 0;
   int dirty = true;
@@ -523,17 +1448,61 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
   bool right_down = false;
   uint32_t left_down_repeat = 0;
   uint32_t right_down_repeat = 0;
-
-  std::vector<carousel::CarouselCard> render_order;
-  uint32_t frame_delay = 1000 / carousel.fps;
+  // Finishing a jump, see JumpTo().
+  bool fast_forward = false;
+
+  // Type to search, opened with '/'.
+  bool search_open = false;
+  std::string search;
+  search.reserve(64);
+  bool search_found = true;
+  uint32_t search_close = 0;
+
+
+  // Frames are paced by the display.  With vsync, presenting blocks until the
+  // next refresh; fps only caps the rate below that.
+  int refresh = DEFAULT_REFRESH;
+  SDL_DisplayMode mode;
+  if (SDL_GetWindowDisplayMode(SDL_RenderGetWindow(ren), &mode) == 0 &&
+      mode.refresh_rate > 0) {
+    refresh = mode.refresh_rate;
+  }
+  const int target_fps =
+      carousel.fps > 0 ? std::min(carousel.fps, refresh) : refresh;
+  SDL_RendererInfo info;
+  const bool vsync = SDL_GetRendererInfo(ren, &info) == 0 &&
+                     (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+  const Uint64 counter_freq = SDL_GetPerformanceFrequency();
+  const Uint64 frame_period = counter_freq / target_fps;
+  uint32_t frame_delay = 1000 / target_fps;
+  Uint64 frame_start = SDL_GetPerformanceCounter();
+  Uint64 last_frame_micros = g_trace.frame_micros();
+  const bool wait_blocks = EventWaitBlocks();
+  // For frame time, the last present if the previous frame drew one.
+  Uint64 last_present = 0;
+  bool drew_last_frame = false;
+  // SDL timestamp of the oldest input not yet shown, 0 if none.
+  Uint32 input_ticks = 0;
+
+  uint32_t wakeups = 0;
+  uint32_t wakeups_since = g_trace.Ticks();
 
   uint32_t last_tick = -1;
   int sp = carousel.width / carousel.num_slots;
 
-  uint32_t next_saver = SDL_GetTicks() + carousel.timeout * 1000;
+  uint32_t next_saver = g_trace.Ticks() + carousel.timeout * 1000;
   bool screensaver = false;
-
-  uint32_t next_volume = SDL_GetTicks();
+  SDL_Rect saver_dest;
+  // The scene texture no longer matches the background and cards.
+  bool scene_dirty = true;
+  // Files changed while the screen saver was on.
+  bool changes_waiting = false;
+  // The card the carousel is stopped on, -1 while it moves, and since when.
+  int dwell_card = -1;
+  uint32_t dwell_since = 0;
+  bool readahead_started = false;
+
+  uint32_t next_volume = g_trace.Ticks();
   bool show_volume = false;
 
 #ifdef ALSA_FOUND
@@ -557,25 +1526,87 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
 #endif
 
   while (!ended) {
-    // Handle carousel spin.
+    if (!g_trace.NextFrame()) {
+      // Replay finished.
+      rc = RC_QUIT;
+      break;
+    }
+    // Animation advances by the time the last frame took, so spin speed does
+    // not depend on the frame rate.
+    float dt = std::min((g_trace.frame_micros() - last_frame_micros) / 1e6f,
+                        MAX_FRAME_TIME);
+    last_frame_micros = g_trace.frame_micros();
+    frame_start = SDL_GetPerformanceCounter();
+    bool presented = false;
+
+    ++wakeups;
+    if (carousel.log_wakeups && g_trace.Ticks() - wakeups_since >= 60000) {
+      uint32_t elapsed = g_trace.Ticks() - wakeups_since;
+      std::cerr << wakeups * 60000.0 / elapsed << " wakeups per minute over "
+                << elapsed / 1000 << "s" << std::endl;
+      wakeups = 0;
+      wakeups_since += elapsed;
+    }
+
+#ifdef COUNT_ALLOCS
+    carousel::StepSpinScript(g_pending_images.empty());
+#endif
+
+    // Upload whatever has been decoded since the last frame and swap it in
+    // for the placeholders.  Replays wait for every image so each run draws
+    // the same thing.
+    if (g_trace.replaying()) {
+      if (!g_pending_images.empty()) {
+        while (!g_pending_images.empty()) {
+          if (!PumpImages(carousel, ren, frame_delay)) {
+            SDL_Delay(1);
+          }
+        }
+        FillCarouselImages(carousel);
+        scene_dirty = true;
+        if (!screensaver) {
+          dirty = true;
+        }
+      }
+    } else if (PumpImages(carousel, ren, frame_delay / 2)) {
+      FillCarouselImages(carousel);
+      scene_dirty = true;
+      // The screen saver does not show cards.
+      if (!screensaver) {
+        dirty = true;
+      }
+    }
+
+    // Handle carousel spin.  initial_speed + speed is in cards per second.
     if (dir != DIR_NONE) {
-      spin_pos = spin_pos +
-                 dir * (sp / carousel.fps * (carousel.initial_speed + speed));
-      if (spin_pos >= sp || spin_pos <= -sp) {
+      const int rate =
+          fast_forward ? FAST_FORWARD_RATE : carousel.initial_speed + speed;
+      spin_pos += dir * sp * rate * dt;
+      while (!ended && dir != DIR_NONE && (spin_pos >= sp || spin_pos <= -sp)) {
+        g_stats.spin_steps++;
         if (dir == DIR_LEFT) {
           ended = move_left(carousel);
         } else if (dir == DIR_RIGHT) {
           ended = move_right(carousel);
         }
-        spin_pos = 0;
+        // Slide the resident window along, prefetching the way we spin.  A
+        // jump already loaded where it ends up.
+        if (carousel.residency_window > 0 && !fast_forward) {
+          UpdateWindow(carousel, dir);
+        }
+        // Carry the overshoot into the next card so the motion stays even.
+        spin_pos -= dir * sp;
         if (speed > 0) {
           speed--;
         } else {
           dir = DIR_NONE;
+          spin_pos = 0;
+          fast_forward = false;
         }
         carousel::PlayClick(carousel);
       }
       dirty = true;
+      scene_dirty = true;
     }
 
     if (showing_patience && carousel.patience_texture == NULL) {
@@ -587,27 +1618,25 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
     }
 
     if (dirty) {
-      // The loading indicator changes the renderer draw color while it is
-      // active. Set it explicitly so transparent screen saver images are
-      // composited over a black screen.
-      SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-      SDL_RenderClear(ren);
+      // The carousel at rest is kept in the scene texture and only drawn
+      // again when it changes, so overlays cost a copy of it.  The copy
+      // covers the whole screen.
+      const bool use_scene = !screensaver && !showing_patience &&
+                             dir == DIR_NONE && carousel.scene_texture != NULL;
+      if (!use_scene) {
+        // The loading indicator changes the renderer draw color while it is
+        // active. Set it explicitly so transparent screen saver images are
+        // composited over a black screen.
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+        SDL_RenderClear(ren);
+      }
 
+      // Positions and draw order come from the layout table.  The card
+      // coming to the front is drawn last once it is past the half way
+      // point.
+      Uint64 layout_start = SDL_GetPerformanceCounter();
       carousel.SetCarouselPositions(spin_pos);
-
-      // For rendering order, sort by their top left y position which
-      // should always draw the biggest card last. As the card
-      // that's coming to the front reaches the half way
-      // point, it's drawn last.
-      render_order.clear();
-
-      for (int k = 0; k < carousel.num_slots; k++) {
-        carousel::CarouselCard card;
-        card.index = k;
-        card.y = carousel.carousel_pos[k].y;
-        render_order.push_back(card);
-      }
-      std::sort(render_order.begin(), render_order.end(), carousel::SortByY);
+      Uint64 copy_start = SDL_GetPerformanceCounter();
 
       if (!screensaver) {
         if (showing_patience) {
@@ -617,22 +1646,19 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
           dest.w = 640;
           dest.h = 480;
           SDL_RenderCopy(ren, carousel.patience_texture, NULL, &dest);
-        } else {
-          SDL_RenderCopy(ren, carousel.background_texture, NULL, NULL);
-          for (size_t i = 0; i < render_order.size(); i++) {
-            SDL_RenderCopy(ren, carousel.carousel_image[render_order.at(i).index],
-                         NULL,
-                         &carousel.carousel_pos[render_order.at(i).index]);
+        } else if (use_scene) {
+          if (scene_dirty) {
+            SDL_SetRenderTarget(ren, carousel.scene_texture);
+            DrawScene(carousel, ren);
+            SDL_SetRenderTarget(ren, NULL);
+            scene_dirty = false;
           }
+          SDL_RenderCopy(ren, carousel.scene_texture, NULL, NULL);
+        } else {
+          DrawScene(carousel, ren);
         }
       } else {
-        // pick a random location for our screen saver img
-        SDL_Rect dest;
-        dest.x = std::max(0, std::rand() % carousel.width - 260);
-        dest.y = std::max(0, std::rand() % carousel.height - 260);
-        dest.w = 260;
-        dest.h = 260;
-        SDL_RenderCopy(ren, carousel.screensaver_texture, NULL, &dest);
+        SDL_RenderCopy(ren, carousel.screensaver_texture, NULL, &saver_dest);
       }
 
       if (show_volume) {
@@ -648,17 +1674,53 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
 #endif
       }
 
+      if (search_open && !screensaver && !showing_patience) {
+        RenderSearchIndicator(carousel, ren, search.size(), search_found);
+      }
+
+      if (!screensaver && !showing_patience && !g_pending_images.empty()) {
+        size_t pending = std::min(g_pending_images.size(), g_load_total);
+        RenderLoadingIndicator(carousel, ren, g_load_total - pending,
+                               g_load_total);
+      }
+
       // Update the screen
+      Uint64 present_start = SDL_GetPerformanceCounter();
       SDL_RenderPresent(ren);
+      Uint64 present_end = SDL_GetPerformanceCounter();
+      g_trace.FrameTimings(copy_start - layout_start,
+                           present_start - copy_start,
+                           present_end - present_start);
+      if (drew_last_frame) {
+        g_stats.frame_time.Record((present_end - last_present) * 1000000 /
+                                  counter_freq);
+      }
+      last_present = present_end;
+      if (input_ticks != 0) {
+        g_stats.input_latency.Record((Uint64)(SDL_GetTicks() - input_ticks) *
+                                     1000);
+        input_ticks = 0;
+      }
       dirty = false;
+      presented = true;
     }
+    drew_last_frame = presented;
 
-    uint32_t now = SDL_GetTicks();
-    uint32_t this_delay = frame_delay - std::min(now - last_tick, frame_delay);
+    uint32_t now = g_trace.Ticks();
 
+    // The screen saver draws only when its image moves, every 5 seconds.
     if (now >= next_saver) {
       next_saver = now + 5000;
+      if (!screensaver) {
+        ShedImages(carousel);
+        scene_dirty = true;
+      }
       screensaver = true;
+      // pick a random location for our screen saver img
+      saver_dest.x = std::max(0, std::rand() % carousel.width - 260);
+      saver_dest.y = std::max(0, std::rand() % carousel.height - 260);
+      saver_dest.w = 260;
+      saver_dest.h = 260;
       dirty = true;
     }
 
@@ -668,16 +1730,56 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
       dirty = true;
     }
 
+    if (search_open && now >= search_close) {
+      search_open = false;
+      dirty = true;
+    }
+
     SDL_Event event;
     SDL_KeyboardEvent* ke = (SDL_KeyboardEvent*)&event;
     SDL_MouseMotionEvent* mme = (SDL_MouseMotionEvent*)&event;
-    while (SDL_PollEvent(&event)) {
+    while (g_trace.PollEvent(&event)) {
+      if (event.type == g_stats_event) {
+        g_stats.Dump(carousel.stats_file);
+        continue;
+      }
+      if (event.type == g_reload_event) {
+        // The screen saver has given back images; changes wait for it to end.
+        if (screensaver) {
+          changes_waiting = true;
+        } else if (ApplyChanges(carousel)) {
+          dir = DIR_NONE;
+          speed = 0;
+          spin_pos = 0;
+        }
+        dirty = true;
+        scene_dirty = true;
+        continue;
+      }
+      // Replayed events have no timestamp.
+      if (input_ticks == 0 && event.common.timestamp != 0 &&
+          (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP ||
+           event.type == SDL_MOUSEMOTION ||
+           event.type == SDL_MOUSEBUTTONUP)) {
+        input_ticks = event.common.timestamp;
+      }
       switch (event.type) {
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+          // The scene texture's contents are gone.
+          scene_dirty = true;
+          dirty = true;
+          break;
         case SDL_MOUSEMOTION:
           if (ignore_first_moust_motion) {
             ignore_first_moust_motion = false;
             break;
           }
+          // Spinning behind the screen saver would only wake the loop.
+          if (screensaver) {
+            break;
+          }
+          fast_forward = false;
           if (!carousel.reverse_keys) {
             if (mme->xrel < 0) {
               speed = std::min(-mme->xrel / 10, MAX_SPEED);
@@ -697,7 +1799,27 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
           }
           break;
         case SDL_KEYDOWN:
-          if (screensaver) {
+          // Keys typed into a search only count when let go.
+          if (screensaver || (search_open && IsSearchKey(ke->keysym.sym))) {
+            break;
+          }
+          // Jump to the next or previous letter.
+          if ((ke->keysym.sym == SDLK_PAGEDOWN ||
+               ke->keysym.sym == SDLK_PAGEUP) &&
+              !showing_patience) {
+            const int step = ke->keysym.sym == SDLK_PAGEDOWN ? 1 : -1;
+            const int to = carousel.search[current_genre].NextGroup(
+                get_selected_index(carousel), step);
+            int jump_speed;
+            int jump_dir = JumpTo(carousel, to, &jump_speed);
+            if (jump_dir != DIR_NONE) {
+              dir = jump_dir;
+              speed = jump_speed;
+              spin_pos = 0;
+              fast_forward = true;
+              dirty = true;
+              scene_dirty = true;
+            }
             break;
           }
           if (!carousel.reverse_keys) {
@@ -735,8 +1857,8 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
         case SDL_MOUSEBUTTONUP:
           if (!patience_needed(carousel) || showing_patience) {
             ended = select_game(carousel, screensaver);
-            if (getCard(carousel, get_selected_index(carousel)).emu == "")
-               if (getCard(carousel, get_selected_index(carousel)).back)
+            if (carousel.cards.emu[getCard(carousel, get_selected_index(carousel))] < 0)
+               if (carousel.cards.flags[getCard(carousel, get_selected_index(carousel))] & CARD_BACK)
                    rc = RC_UPDIR;
                else
                    rc = RC_INDIR;
@@ -748,11 +1870,50 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
           }
           break;
         case SDL_KEYUP:
+          if (search_open && IsSearchKey(ke->keysym.sym)) {
+            const SDL_Keycode key = ke->keysym.sym;
+            if (key == SDLK_ESCAPE || key == SDLK_RETURN) {
+              // The selection stays where the search took it.
+              search_open = false;
+            } else {
+              if (key == SDLK_BACKSPACE) {
+                if (!search.empty()) {
+                  search.erase(search.size() - 1);
+                }
+              } else {
+                search.push_back((char)key);
+              }
+              const int to = carousel.search[current_genre].Find(search);
+              search_found = search.empty() || to >= 0;
+              int jump_speed;
+              int jump_dir = JumpTo(carousel, to, &jump_speed);
+              if (jump_dir != DIR_NONE) {
+                dir = jump_dir;
+                speed = jump_speed;
+                spin_pos = 0;
+                fast_forward = true;
+                scene_dirty = true;
+              }
+              search_close = now + SEARCH_TIMEOUT_MS;
+            }
+            dirty = true;
+            next_saver = last_tick + carousel.timeout * 1000;
+            break;
+          }
           switch (ke->keysym.sym) {
             case SDLK_ESCAPE:
               ended = true;
               rc = RC_QUIT;
               break;
+            case SDLK_SLASH:
+              if (!screensaver && !showing_patience) {
+                search_open = true;
+                search.clear();
+                search_found = true;
+                search_close = now + SEARCH_TIMEOUT_MS;
+                dirty = true;
+              }
+              break;
             case SDLK_UP:
 #ifdef ALSA_FOUND
               if (carousel.mixer_opened) {
@@ -762,7 +1923,7 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
                 }
                 snd_mixer_selem_set_playback_volume_all(carousel.elem, volume);
                 carousel::PlayBlip(carousel);
-                next_volume = SDL_GetTicks() + 5 * 1000;
+                next_volume = g_trace.Ticks() + 5 * 1000;
                 show_volume = true;
                 dirty = true;
               }
@@ -777,7 +1938,7 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
                 }
                 snd_mixer_selem_set_playback_volume_all(carousel.elem, volume);
                 carousel::PlayBlip(carousel);
-                next_volume = SDL_GetTicks() + 5 * 1000;
+                next_volume = g_trace.Ticks() + 5 * 1000;
                 show_volume = true;
                 dirty = true;
               }
@@ -796,8 +1957,8 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
             case SDLK_a:
               if (!patience_needed(carousel) || showing_patience) {
                 ended = select_game(carousel, screensaver);
-                if (getCard(carousel, get_selected_index(carousel)).emu == "")
-                   if (getCard(carousel, get_selected_index(carousel)).back)
+                if (carousel.cards.emu[getCard(carousel, get_selected_index(carousel))] < 0)
+                   if (carousel.cards.flags[getCard(carousel, get_selected_index(carousel))] & CARD_BACK)
                        rc = RC_UPDIR;
                    else
                        rc = RC_INDIR;
@@ -843,7 +2004,13 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
           // Not in screen saver any more.
           next_saver = last_tick + carousel.timeout * 1000;
           if (screensaver) {
+            RestoreImages(carousel);
+            if (changes_waiting) {
+              ApplyChanges(carousel);
+              changes_waiting = false;
+            }
             dirty = true;
+            scene_dirty = true;
           }
           screensaver = false;
 
@@ -861,6 +2028,7 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
     if (left_down && now >= left_down_repeat) {
       left_down_repeat = left_down_repeat + 1000;
       dirty = true;
+      fast_forward = false;
       if (dir == DIR_LEFT) {
         // Already moving in that dir. Increase speed.
         speed = std::min(speed + 1, MAX_SPEED);
@@ -874,6 +2042,7 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
     } else if (right_down && now >= right_down_repeat) {
       right_down_repeat = right_down_repeat + 1000;
       dirty = true;
+      fast_forward = false;
       if (dir == DIR_RIGHT) {
         // Already moving in that dir. Increase speed.
         speed = std::min(speed + 1, MAX_SPEED);
@@ -886,9 +2055,85 @@ int rendering_loop(carousel::Carousel& carousel, SDL_Renderer* ren) {
       }
     }
 
-    SDL_Delay(this_delay);
+    // Read ahead the ROM of a game the carousel stays on.  Moving on, or
+    // the screen saver, drops it.
+    if (carousel.readahead_dwell > 0) {
+      const int card = dir == DIR_NONE && !screensaver
+                           ? getCard(carousel, get_selected_index(carousel))
+                           : -1;
+      if (card != dwell_card) {
+        if (readahead_started) {
+          g_readahead.Cancel();
+          readahead_started = false;
+        }
+        dwell_card = card;
+        dwell_since = now;
+      } else if (card >= 0 && !readahead_started &&
+                 now - dwell_since >= (uint32_t)carousel.readahead_dwell) {
+        const int emu = carousel.cards.emu[card];
+        if (emu >= 0) {
+          g_readahead.Request(carousel.emulators[emu].cmd,
+                              carousel.roms.Get(carousel.cards.rom[card]),
+                              (Uint64)carousel.readahead_limit * 1024 * 1024);
+        }
+        readahead_started = true;
+      }
+    }
+
+    // With nothing moving, drawing or loading, sleep until there is input or
+    // something is due: the screen saver, hiding the volume, a key repeat or
+    // a readahead.
+    const bool idle = dir == DIR_NONE && !dirty && g_pending_images.empty();
+    if (idle) {
+      // The input changed nothing on screen.
+      input_ticks = 0;
+    }
+    if (g_trace.replaying()) {
+      // Replays run as fast as they can.
+    } else if (idle) {
+      uint32_t wake = next_saver;
+      if (show_volume && (int32_t)(next_volume - wake) < 0) {
+        wake = next_volume;
+      }
+      if (left_down && (int32_t)(left_down_repeat - wake) < 0) {
+        wake = left_down_repeat;
+      }
+      if (right_down && (int32_t)(right_down_repeat - wake) < 0) {
+        wake = right_down_repeat;
+      }
+      if (search_open && (int32_t)(search_close - wake) < 0) {
+        wake = search_close;
+      }
+      const uint32_t dwell_end = dwell_since + carousel.readahead_dwell;
+      if (dwell_card >= 0 && !readahead_started &&
+          (int32_t)(dwell_end - wake) < 0) {
+        wake = dwell_end;
+      }
+      int32_t timeout = std::max((int32_t)(wake - g_trace.Ticks()), 0);
+#ifdef COUNT_ALLOCS
+      // The spin script needs to run every frame.
+      timeout = std::min(timeout, (int32_t)frame_delay);
+#endif
+      if (wait_blocks) {
+        // Leaves the event queued for the next iteration.
+        SDL_WaitEventTimeout(NULL, timeout);
+      } else {
+        WaitForInput(timeout, frame_delay);
+      }
+    } else if (!presented || !vsync || target_fps < refresh) {
+      // A vsynced present has already waited for the display.  Otherwise
+      // sleep out the rest of the frame.
+      Uint64 elapsed = SDL_GetPerformanceCounter() - frame_start;
+      if (elapsed < frame_period) {
+        SDL_Delay((Uint32)((frame_period - elapsed) * 1000 / counter_freq));
+      }
+    }
     last_tick = now;
   }
 
+  // Leave the images as the next screen expects to find them.
+  if (screensaver) {
+    RestoreImages(carousel);
+  }
   return rc;
 }
@@ -0,0 +1,201 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace carousel {
+
+void MipLayout(int w, int h, SDL_Rect levels[MIP_LEVELS]) {
+  levels[0].x = 0;
+  levels[0].y = 0;
+  levels[0].w = w;
+  levels[0].h = h;
+  int y = 0;
+  for (int i = 1; i < MIP_LEVELS; ++i) {
+    levels[i].x = w + IMAGE_GUTTER;
+    levels[i].y = y;
+    levels[i].w = std::max(1, w >> i);
+    levels[i].h = std::max(1, h >> i);
+    y += levels[i].h + IMAGE_GUTTER;
+  }
+}
+
+void MipChainSize(int w, int h, int* chain_w, int* chain_h) {
+  SDL_Rect levels[MIP_LEVELS];
+  MipLayout(w, h, levels);
+  *chain_w = w;
+  *chain_h = h;
+  for (int i = 1; i < MIP_LEVELS; ++i) {
+    *chain_w = std::max(*chain_w, levels[i].x + levels[i].w);
+    *chain_h = std::max(*chain_h, levels[i].y + levels[i].h);
+  }
+}
+
+namespace {
+
+// Source pixels (and their weights) that make up each output pixel along one
+// axis.
+struct Taps {
+  std::vector<int> first;
+  std::vector<int> count;
+  std::vector<int> offset;
+  std::vector<float> weight;
+};
+
+void BuildTaps(int src_len, int dst_len, Taps* taps) {
+  const double scale = (double)src_len / dst_len;
+  for (int i = 0; i < dst_len; ++i) {
+    taps->offset.push_back(taps->weight.size());
+    if (scale > 1.0) {
+      // Shrinking: average everything the output pixel covers.
+      const double start = i * scale;
+      const double end = start + scale;
+      const int first = (int)start;
+      const int last = std::min((int)std::ceil(end), src_len);
+      for (int j = first; j < last; ++j) {
+        double covered =
+            std::min(end, j + 1.0) - std::max(start, (double)j);
+        taps->weight.push_back((float)(covered / scale));
+      }
+      taps->first.push_back(first);
+      taps->count.push_back(last - first);
+    } else {
+      // Growing: interpolate between the two nearest source pixels.
+      const double u = std::max(0.0, (i + 0.5) * scale - 0.5);
+      const int first = std::min((int)u, src_len - 1);
+      const float frac = (float)(u - first);
+      taps->first.push_back(first);
+      if (first + 1 < src_len && frac > 0.0f) {
+        taps->weight.push_back(1.0f - frac);
+        taps->weight.push_back(frac);
+        taps->count.push_back(2);
+      } else {
+        taps->weight.push_back(1.0f);
+        taps->count.push_back(1);
+      }
+    }
+  }
+}
+
+inline Uint32* Row(SDL_Surface* surface, int y) {
+  return (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+}
+
+inline Uint32 Pack(const float c[4]) {
+  Uint32 p = 0;
+  for (int k = 0; k < 4; ++k) {
+    int v = (int)(c[k] + 0.5f);
+    v = std::max(0, std::min(255, v));
+    p |= (Uint32)v << (k * 8);
+  }
+  return p;
+}
+
+// Resample src into dst with a separable filter.  Both are ARGB8888.
+void Resample(SDL_Surface* src, SDL_Surface* dst) {
+  Taps xt, yt;
+  BuildTaps(src->w, dst->w, &xt);
+  BuildTaps(src->h, dst->h, &yt);
+
+  // Horizontal pass into a float buffer of dst->w x src->h.
+  std::vector<float> tmp(dst->w * src->h * 4);
+  for (int y = 0; y < src->h; ++y) {
+    const Uint32* row = Row(src, y);
+    float* out = &tmp[y * dst->w * 4];
+    for (int x = 0; x < dst->w; ++x) {
+      float c[4] = {0, 0, 0, 0};
+      const float* w = &xt.weight[xt.offset[x]];
+      const Uint32* p = row + xt.first[x];
+      for (int k = 0; k < xt.count[x]; ++k) {
+        for (int ch = 0; ch < 4; ++ch) {
+          c[ch] += w[k] * ((p[k] >> (ch * 8)) & 0xff);
+        }
+      }
+      for (int ch = 0; ch < 4; ++ch) {
+        out[x * 4 + ch] = c[ch];
+      }
+    }
+  }
+
+  // Vertical pass into dst.
+  for (int y = 0; y < dst->h; ++y) {
+    Uint32* out = Row(dst, y);
+    const float* w = &yt.weight[yt.offset[y]];
+    for (int x = 0; x < dst->w; ++x) {
+      float c[4] = {0, 0, 0, 0};
+      for (int k = 0; k < yt.count[y]; ++k) {
+        const float* in = &tmp[((yt.first[y] + k) * dst->w + x) * 4];
+        for (int ch = 0; ch < 4; ++ch) {
+          c[ch] += w[k] * in[ch];
+        }
+      }
+      out[x] = Pack(c);
+    }
+  }
+}
+
+// Box filter the w x h region at src_rect into the half sized dst_rect of
+// the same surface.
+void Halve(SDL_Surface* surface, const SDL_Rect& src_rect,
+           const SDL_Rect& dst_rect) {
+  for (int y = 0; y < dst_rect.h; ++y) {
+    const int y0 = std::min(y * 2, src_rect.h - 1);
+    const int y1 = std::min(y * 2 + 1, src_rect.h - 1);
+    const Uint32* r0 = Row(surface, src_rect.y + y0) + src_rect.x;
+    const Uint32* r1 = Row(surface, src_rect.y + y1) + src_rect.x;
+    Uint32* out = Row(surface, dst_rect.y + y) + dst_rect.x;
+    for (int x = 0; x < dst_rect.w; ++x) {
+      const int x0 = std::min(x * 2, src_rect.w - 1);
+      const int x1 = std::min(x * 2 + 1, src_rect.w - 1);
+      float c[4];
+      for (int ch = 0; ch < 4; ++ch) {
+        const int shift = ch * 8;
+        c[ch] = (((r0[x0] >> shift) & 0xff) + ((r0[x1] >> shift) & 0xff) +
+                 ((r1[x0] >> shift) & 0xff) + ((r1[x1] >> shift) & 0xff)) /
+                4.0f;
+      }
+      out[x] = Pack(c);
+    }
+  }
+}
+
+}  // namespace
+
+SDL_Surface* BuildMipChain(SDL_Surface* src, int w, int h) {
+  int chain_w, chain_h;
+  MipChainSize(w, h, &chain_w, &chain_h);
+  SDL_Surface* chain = SDL_CreateRGBSurfaceWithFormat(
+      0, chain_w, chain_h, 32, SDL_PIXELFORMAT_ARGB8888);
+  SDL_Surface* level0 =
+      SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (chain == NULL || level0 == NULL) {
+    SDL_FreeSurface(chain);
+    SDL_FreeSurface(level0);
+    return NULL;
+  }
+  SDL_FillRect(chain, NULL, 0);
+
+  Resample(src, level0);
+  for (int y = 0; y < h; ++y) {
+    SDL_memcpy(Row(chain, y), Row(level0, y), w * sizeof(Uint32));
+  }
+  SDL_FreeSurface(level0);
+
+  SDL_Rect levels[MIP_LEVELS];
+  MipLayout(w, h, levels);
+  for (int i = 1; i < MIP_LEVELS; ++i) {
+    Halve(chain, levels[i - 1], levels[i]);
+  }
+  return chain;
+}
+
+int PickMipLevel(const SDL_Rect levels[MIP_LEVELS], int dest_w) {
+  int level = 0;
+  while (level + 1 < MIP_LEVELS && levels[level + 1].w >= dest_w) {
+    ++level;
+  }
+  return level;
+}
+
+}  // namespace carousel
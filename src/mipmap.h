@@ -0,0 +1,41 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <SDL2/SDL.h>
+
+namespace carousel {
+
+// Number of levels in a card's mip chain, full size included.  Each level is
+// half the size of the one before it.
+#define MIP_LEVELS 3
+
+// Pixels left between the levels of a mip chain, and between the chains in
+// an atlas, so filtering never samples a neighbour.
+#define IMAGE_GUTTER 1
+
+/*
+ * Where each level of a w x h card lives inside its mip chain image.  Level 0
+ * is at the top left; the smaller levels are stacked in a column to its right.
+ */
+void MipLayout(int w, int h, SDL_Rect levels[MIP_LEVELS]);
+
+/*
+ * Size of the image holding a complete mip chain for a w x h card.
+ */
+void MipChainSize(int w, int h, int* chain_w, int* chain_h);
+
+/*
+ * Resample an ARGB8888 surface to w x h and build its mip chain.  Returns a
+ * new ARGB8888 surface laid out as described by MipLayout(), or NULL.
+ */
+SDL_Surface* BuildMipChain(SDL_Surface* src, int w, int h);
+
+/*
+ * Index of the level that best matches drawing a card dest_w pixels wide:
+ * the smallest level that is still at least that wide.
+ */
+int PickMipLevel(const SDL_Rect levels[MIP_LEVELS], int dest_w);
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,154 @@
+// Builds the asset pack: every card image referenced by carousel.cfg, decoded
+// and resampled for the display it will be shown on, in one file the
+// carousel maps at startup.
+//
+// Usage: CarouselPack [display height]
+//
+// Run it from the directory holding carousel.cfg, like the carousel itself.
+// Without a height the current display's height is used.
+
+#include <SDL2/SDL.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+#include "carousel.h"
+#include "image_loader.h"
+#include "mipmap.h"
+#include "res_path.h"
+
+static Uint64 Align(Uint64 offset) {
+  return (offset + ASSET_PACK_ALIGN - 1) / ASSET_PACK_ALIGN * ASSET_PACK_ALIGN;
+}
+
+int main(int argc, char** argv) {
+  carousel::Carousel carousel;
+  if (!carousel.ParseConfig()) {
+    std::cerr << "Could not parse config file" << std::endl;
+    return 1;
+  }
+
+  if (argc > 1) {
+    carousel.height = atoi(argv[1]);
+  } else {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+      std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
+      return 1;
+    }
+    SDL_DisplayMode current;
+    if (SDL_GetCurrentDisplayMode(0, &current) == 0) {
+      carousel.height = current.h;
+    }
+    SDL_Quit();
+  }
+  if (carousel.height <= 0) {
+    std::cerr << "Could not find display height, pass it as an argument"
+              << std::endl;
+    return 1;
+  }
+
+  int card_w, card_h, chain_w, chain_h;
+  carousel.CardSize(&card_w, &card_h);
+  carousel::MipChainSize(card_w, card_h, &chain_w, &chain_h);
+  const Uint64 chain_bytes = (Uint64)chain_w * chain_h * 4;
+
+  // Every distinct card image, including the back card.
+  std::set<std::string> names;
+  carousel.UsedImages(&names);
+
+  carousel::PackHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+  header.version = ASSET_PACK_VERSION;
+  header.card_w = card_w;
+  header.card_h = card_h;
+  header.chain_w = chain_w;
+  header.chain_h = chain_h;
+  header.count = names.size();
+
+  std::vector<carousel::PackEntry> entries;
+  std::string name_blob;
+  Uint32 names_start =
+      sizeof(carousel::PackHeader) + names.size() * sizeof(carousel::PackEntry);
+  for (std::set<std::string>::iterator it = names.begin(); it != names.end();
+       ++it) {
+    std::string path = carousel::GetResourcePath() + *it;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      std::cerr << "Missing image " << path << std::endl;
+      return 1;
+    }
+    carousel::PackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.name_offset = names_start + name_blob.size();
+    entry.name_length = it->size();
+    entry.source_mtime = st.st_mtime;
+    entry.source_size = st.st_size;
+    entries.push_back(entry);
+    name_blob += *it;
+  }
+  Uint64 offset = Align(names_start + name_blob.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].data_offset = offset;
+    offset = Align(offset + chain_bytes);
+  }
+
+  // Write to a temporary file so a running carousel never maps a partial
+  // pack.
+  std::string pack_path = carousel::GetResourcePath() + ASSET_PACK_FILE;
+  std::string tmp_path = pack_path + ".tmp";
+  std::ofstream file(tmp_path.c_str(), std::ofstream::out |
+                                           std::ofstream::binary |
+                                           std::ofstream::trunc);
+  if (file.fail()) {
+    std::cerr << "Could not write " << tmp_path << std::endl;
+    return 1;
+  }
+  file.write((const char*)&header, sizeof(header));
+  file.write((const char*)&entries[0],
+             entries.size() * sizeof(carousel::PackEntry));
+  file.write(name_blob.data(), name_blob.size());
+
+  int index = 0;
+  for (std::set<std::string>::iterator it = names.begin(); it != names.end();
+       ++it, ++index) {
+    SDL_Surface* decoded = carousel::DecodeImage(*it);
+    SDL_Surface* chain =
+        decoded == NULL ? NULL
+                        : carousel::BuildMipChain(decoded, card_w, card_h);
+    SDL_FreeSurface(decoded);
+    if (chain == NULL) {
+      std::cerr << "Could not build " << *it << std::endl;
+      file.close();
+      remove(tmp_path.c_str());
+      return 1;
+    }
+
+    // Pad up to the entry's page aligned offset.
+    std::string padding(entries[index].data_offset - (Uint64)file.tellp(), 0);
+    file.write(padding.data(), padding.size());
+    for (int y = 0; y < chain->h; ++y) {
+      file.write((const char*)chain->pixels + y * chain->pitch, chain->w * 4);
+    }
+    SDL_FreeSurface(chain);
+  }
+
+  file.close();
+  if (file.fail() || rename(tmp_path.c_str(), pack_path.c_str()) != 0) {
+    std::cerr << "Could not write " << pack_path << std::endl;
+    remove(tmp_path.c_str());
+    return 1;
+  }
+
+  std::cout << "Packed " << names.size() << " images at " << card_w << "x"
+            << card_h << " into " << pack_path << std::endl;
+  return 0;
+}
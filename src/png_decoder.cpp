@@ -0,0 +1,303 @@
+#include "png_decoder.h"
+
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
+#include <cstdlib>
+
+namespace carousel {
+
+#ifdef ZLIB_FOUND
+
+namespace {
+
+const Uint8 kSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+enum { kGray = 0, kRgb = 2, kPalette = 3, kGrayAlpha = 4, kRgba = 6 };
+
+inline Uint32 ReadBE32(const Uint8* p) {
+  return (Uint32)p[0] << 24 | (Uint32)p[1] << 16 | (Uint32)p[2] << 8 | p[3];
+}
+
+inline void WriteBE32(std::vector<Uint8>* out, Uint32 v) {
+  out->push_back(v >> 24);
+  out->push_back(v >> 16);
+  out->push_back(v >> 8);
+  out->push_back(v);
+}
+
+inline Uint8 Paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = abs(p - a);
+  const int pb = abs(p - b);
+  const int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return a;
+  }
+  return pb <= pc ? b : c;
+}
+
+// Undo the per row filters in place.  prev is the previous unfiltered row,
+// or NULL for the first.  The Up and Sub loops are plain byte loops on
+// purpose; the compiler vectorizes them.
+bool Unfilter(Uint8 type, Uint8* row, const Uint8* prev, size_t len,
+              size_t bpp) {
+  switch (type) {
+    case 0:
+      return true;
+    case 1:
+      for (size_t i = bpp; i < len; ++i) {
+        row[i] += row[i - bpp];
+      }
+      return true;
+    case 2:
+      if (prev != NULL) {
+        for (size_t i = 0; i < len; ++i) {
+          row[i] += prev[i];
+        }
+      }
+      return true;
+    case 3:
+      for (size_t i = 0; i < len; ++i) {
+        const int left = i >= bpp ? row[i - bpp] : 0;
+        const int up = prev != NULL ? prev[i] : 0;
+        row[i] += (left + up) >> 1;
+      }
+      return true;
+    case 4:
+      for (size_t i = 0; i < len; ++i) {
+        const int left = i >= bpp ? row[i - bpp] : 0;
+        const int up = prev != NULL ? prev[i] : 0;
+        const int up_left = (prev != NULL && i >= bpp) ? prev[i - bpp] : 0;
+        row[i] += Paeth(left, up, up_left);
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+SDL_Surface* DecodePng(const Uint8* data, size_t size) {
+  if (size < sizeof(kSignature) ||
+      SDL_memcmp(data, kSignature, sizeof(kSignature)) != 0) {
+    SDL_SetError("Not a PNG image");
+    return NULL;
+  }
+
+  Uint32 width = 0, height = 0;
+  Uint8 depth = 0, color = 0, interlace = 0;
+  Uint32 palette[256];
+  for (int i = 0; i < 256; ++i) {
+    palette[i] = 0xff000000;
+  }
+  std::vector<Uint8> compressed;
+
+  size_t pos = sizeof(kSignature);
+  while (pos + 12 <= size) {
+    const Uint32 length = ReadBE32(data + pos);
+    const Uint8* type = data + pos + 4;
+    const Uint8* chunk = data + pos + 8;
+    if (length > size - pos - 12) {
+      SDL_SetError("Truncated PNG image");
+      return NULL;
+    }
+    if (SDL_memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+      width = ReadBE32(chunk);
+      height = ReadBE32(chunk + 4);
+      depth = chunk[8];
+      color = chunk[9];
+      interlace = chunk[12];
+    } else if (SDL_memcmp(type, "PLTE", 4) == 0) {
+      for (Uint32 i = 0; i < length / 3 && i < 256; ++i) {
+        palette[i] = 0xff000000 | (Uint32)chunk[i * 3] << 16 |
+                     (Uint32)chunk[i * 3 + 1] << 8 | chunk[i * 3 + 2];
+      }
+    } else if (SDL_memcmp(type, "tRNS", 4) == 0 && color == kPalette) {
+      for (Uint32 i = 0; i < length && i < 256; ++i) {
+        palette[i] = (palette[i] & 0x00ffffff) | (Uint32)chunk[i] << 24;
+      }
+    } else if (SDL_memcmp(type, "IDAT", 4) == 0) {
+      compressed.insert(compressed.end(), chunk, chunk + length);
+    } else if (SDL_memcmp(type, "IEND", 4) == 0) {
+      break;
+    }
+    pos += length + 12;
+  }
+
+  int channels;
+  switch (color) {
+    case kGray:
+    case kPalette:
+      channels = 1;
+      break;
+    case kGrayAlpha:
+      channels = 2;
+      break;
+    case kRgb:
+      channels = 3;
+      break;
+    case kRgba:
+      channels = 4;
+      break;
+    default:
+      channels = 0;
+      break;
+  }
+  const bool depth_ok = color == kPalette
+                            ? (depth == 1 || depth == 2 || depth == 4 ||
+                               depth == 8)
+                            : (depth == 8 || depth == 16);
+  if (width == 0 || height == 0 || width > 16384 || height > 16384 ||
+      channels == 0 || !depth_ok || interlace != 0 || compressed.empty()) {
+    SDL_SetError("Unsupported PNG image");
+    return NULL;
+  }
+
+  const size_t bits = (size_t)channels * depth;
+  const size_t bpp = bits < 8 ? 1 : bits / 8;
+  const size_t stride = (width * bits + 7) / 8;
+  std::vector<Uint8> raw(height * (stride + 1));
+  uLongf raw_size = raw.size();
+  if (uncompress(&raw[0], &raw_size, &compressed[0], compressed.size()) !=
+          Z_OK ||
+      raw_size != raw.size()) {
+    SDL_SetError("Corrupt PNG image data");
+    return NULL;
+  }
+
+  SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
+      0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (surface == NULL) {
+    return NULL;
+  }
+
+  // Samples are 8 bit or the high byte of a 16 bit one.
+  const size_t step = depth == 16 ? 2 : 1;
+  const Uint8* prev = NULL;
+  for (Uint32 y = 0; y < height; ++y) {
+    Uint8* row = &raw[y * (stride + 1)];
+    if (!Unfilter(row[0], row + 1, prev, stride, bpp)) {
+      SDL_FreeSurface(surface);
+      SDL_SetError("Corrupt PNG image filter");
+      return NULL;
+    }
+    const Uint8* in = row + 1;
+    prev = in;
+
+    Uint32* out = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+    switch (color) {
+      case kRgba:
+        for (Uint32 x = 0; x < width; ++x, in += 4 * step) {
+          out[x] = (Uint32)in[3 * step] << 24 | (Uint32)in[0] << 16 |
+                   (Uint32)in[step] << 8 | in[2 * step];
+        }
+        break;
+      case kRgb:
+        for (Uint32 x = 0; x < width; ++x, in += 3 * step) {
+          out[x] = 0xff000000 | (Uint32)in[0] << 16 | (Uint32)in[step] << 8 |
+                   in[2 * step];
+        }
+        break;
+      case kGrayAlpha:
+        for (Uint32 x = 0; x < width; ++x, in += 2 * step) {
+          out[x] = (Uint32)in[step] << 24 | (Uint32)in[0] * 0x010101;
+        }
+        break;
+      case kGray:
+        for (Uint32 x = 0; x < width; ++x, in += step) {
+          out[x] = 0xff000000 | (Uint32)in[0] * 0x010101;
+        }
+        break;
+      case kPalette:
+        for (Uint32 x = 0; x < width; ++x) {
+          const size_t bit = x * depth;
+          const Uint8 v = (in[bit / 8] >> (8 - depth - bit % 8)) &
+                          ((1 << depth) - 1);
+          out[x] = palette[v];
+        }
+        break;
+    }
+  }
+  return surface;
+}
+
+bool EncodePng(SDL_Surface* surface, std::vector<Uint8>* out) {
+  if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+    SDL_SetError("PNG encoder needs ARGB8888");
+    return false;
+  }
+
+  // Unfiltered RGBA rows.
+  const size_t stride = surface->w * 4;
+  std::vector<Uint8> raw(surface->h * (stride + 1));
+  for (int y = 0; y < surface->h; ++y) {
+    const Uint32* in =
+        (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+    Uint8* row = &raw[y * (stride + 1)];
+    *row++ = 0;
+    for (int x = 0; x < surface->w; ++x) {
+      *row++ = in[x] >> 16;
+      *row++ = in[x] >> 8;
+      *row++ = in[x];
+      *row++ = in[x] >> 24;
+    }
+  }
+  std::vector<Uint8> compressed(compressBound(raw.size()));
+  uLongf compressed_size = compressed.size();
+  if (compress2(&compressed[0], &compressed_size, &raw[0], raw.size(), 6) !=
+      Z_OK) {
+    SDL_SetError("PNG compression failed");
+    return false;
+  }
+  compressed.resize(compressed_size);
+
+  out->assign(kSignature, kSignature + sizeof(kSignature));
+  Uint8 header[13] = {0};
+  header[0] = surface->w >> 24;
+  header[1] = surface->w >> 16;
+  header[2] = surface->w >> 8;
+  header[3] = surface->w;
+  header[4] = surface->h >> 24;
+  header[5] = surface->h >> 16;
+  header[6] = surface->h >> 8;
+  header[7] = surface->h;
+  header[8] = 8;
+  header[9] = kRgba;
+
+  const struct {
+    const char* type;
+    const Uint8* data;
+    size_t size;
+  } chunks[] = {{"IHDR", header, sizeof(header)},
+                {"IDAT", &compressed[0], compressed.size()},
+                {"IEND", NULL, 0}};
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
+    WriteBE32(out, chunks[i].size);
+    const size_t start = out->size();
+    out->insert(out->end(), chunks[i].type, chunks[i].type + 4);
+    if (chunks[i].size > 0) {
+      out->insert(out->end(), chunks[i].data, chunks[i].data + chunks[i].size);
+    }
+    WriteBE32(out, crc32(0, &(*out)[start], out->size() - start));
+  }
+  return true;
+}
+
+#else
+
+SDL_Surface* DecodePng(const Uint8*, size_t) {
+  SDL_SetError("PNG support needs zlib, rebuild with it installed");
+  return NULL;
+}
+
+bool EncodePng(SDL_Surface*, std::vector<Uint8>*) {
+  SDL_SetError("PNG support needs zlib, rebuild with it installed");
+  return false;
+}
+
+#endif
+
+}  // namespace carousel
@@ -0,0 +1,23 @@
+#ifndef PNG_DECODER_H
+#define PNG_DECODER_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+namespace carousel {
+
+/*
+ * Decode a non-interlaced PNG image held in memory into a new ARGB8888
+ * surface.  Returns NULL and sets the SDL error on bad or unsupported data,
+ * or when built without zlib.
+ */
+SDL_Surface* DecodePng(const Uint8* data, size_t size);
+
+/*
+ * Encode an ARGB8888 surface as an RGBA PNG, replacing the contents of out.
+ */
+bool EncodePng(SDL_Surface* surface, std::vector<Uint8>* out);
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,182 @@
+#include "qoi.h"
+
+namespace carousel {
+
+namespace {
+
+const Uint8 kOpIndex = 0x00;
+const Uint8 kOpDiff = 0x40;
+const Uint8 kOpLuma = 0x80;
+const Uint8 kOpRun = 0xc0;
+const Uint8 kOpRgb = 0xfe;
+const Uint8 kOpRgba = 0xff;
+const Uint8 kMask2 = 0xc0;
+
+const size_t kHeaderSize = 14;
+const Uint8 kPadding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// Pixels are kept as ARGB8888 words throughout so decoded runs can be
+// stored without repacking.
+inline Uint32 Hash(Uint32 px) {
+  return (((px >> 16) & 0xff) * 3 + ((px >> 8) & 0xff) * 5 +
+          (px & 0xff) * 7 + (px >> 24) * 11) &
+         63;
+}
+
+inline Uint32 ReadBE32(const Uint8* p) {
+  return (Uint32)p[0] << 24 | (Uint32)p[1] << 16 | (Uint32)p[2] << 8 | p[3];
+}
+
+inline void WriteBE32(std::vector<Uint8>* out, Uint32 v) {
+  out->push_back(v >> 24);
+  out->push_back(v >> 16);
+  out->push_back(v >> 8);
+  out->push_back(v);
+}
+
+}  // namespace
+
+SDL_Surface* DecodeQoi(const Uint8* data, size_t size) {
+  if (size < kHeaderSize + sizeof(kPadding) ||
+      SDL_memcmp(data, "qoif", 4) != 0) {
+    SDL_SetError("Not a QOI image");
+    return NULL;
+  }
+  const Uint32 width = ReadBE32(data + 4);
+  const Uint32 height = ReadBE32(data + 8);
+  const Uint8 channels = data[12];
+  if (width == 0 || height == 0 || width > 16384 || height > 16384 ||
+      (channels != 3 && channels != 4)) {
+    SDL_SetError("Unsupported QOI image");
+    return NULL;
+  }
+
+  SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
+      0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (surface == NULL) {
+    return NULL;
+  }
+
+  Uint32 index[64] = {0};
+  Uint32 px = 0xff000000;
+  const Uint8* p = data + kHeaderSize;
+  // Ops never read past the padding, so only the op start needs checking.
+  const Uint8* end = data + size - sizeof(kPadding);
+
+  // 32 bit surfaces have no row padding, decode straight through.
+  Uint32* out = (Uint32*)surface->pixels;
+  Uint32* const out_end = out + width * height;
+  while (out < out_end && p < end) {
+    const Uint8 b1 = *p++;
+    if (b1 == kOpRgb) {
+      px = (px & 0xff000000) | (Uint32)p[0] << 16 | (Uint32)p[1] << 8 | p[2];
+      p += 3;
+    } else if (b1 == kOpRgba) {
+      px = (Uint32)p[3] << 24 | (Uint32)p[0] << 16 | (Uint32)p[1] << 8 | p[2];
+      p += 4;
+    } else if ((b1 & kMask2) == kOpIndex) {
+      px = index[b1];
+    } else if ((b1 & kMask2) == kOpDiff) {
+      const Uint32 r = (((px >> 16) & 0xff) + ((b1 >> 4) & 3) - 2) & 0xff;
+      const Uint32 g = (((px >> 8) & 0xff) + ((b1 >> 2) & 3) - 2) & 0xff;
+      const Uint32 b = ((px & 0xff) + (b1 & 3) - 2) & 0xff;
+      px = (px & 0xff000000) | r << 16 | g << 8 | b;
+    } else if ((b1 & kMask2) == kOpLuma) {
+      const Uint8 b2 = *p++;
+      const int vg = (b1 & 0x3f) - 32;
+      const Uint32 r =
+          (((px >> 16) & 0xff) + vg - 8 + ((b2 >> 4) & 0x0f)) & 0xff;
+      const Uint32 g = (((px >> 8) & 0xff) + vg) & 0xff;
+      const Uint32 b = ((px & 0xff) + vg - 8 + (b2 & 0x0f)) & 0xff;
+      px = (px & 0xff000000) | r << 16 | g << 8 | b;
+    } else {
+      // Runs are the common case for flat card art, fill them in one go.
+      Uint32* run_end = SDL_min(out + (b1 & 0x3f) + 1, out_end);
+      while (out < run_end) {
+        *out++ = px;
+      }
+      index[Hash(px)] = px;
+      continue;
+    }
+    index[Hash(px)] = px;
+    *out++ = px;
+  }
+  // Truncated data leaves the rest of the image empty.
+  return surface;
+}
+
+bool EncodeQoi(SDL_Surface* surface, std::vector<Uint8>* out) {
+  if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+    SDL_SetError("QOI encoder needs ARGB8888");
+    return false;
+  }
+  out->clear();
+  out->reserve(kHeaderSize + surface->w * surface->h + sizeof(kPadding));
+  out->insert(out->end(), "qoif", "qoif" + 4);
+  WriteBE32(out, surface->w);
+  WriteBE32(out, surface->h);
+  out->push_back(4);
+  out->push_back(0);
+
+  Uint32 index[64] = {0};
+  Uint32 prev = 0xff000000;
+  int run = 0;
+  for (int y = 0; y < surface->h; ++y) {
+    const Uint32* row =
+        (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+    for (int x = 0; x < surface->w; ++x) {
+      const Uint32 px = row[x];
+      const bool last = y == surface->h - 1 && x == surface->w - 1;
+      if (px == prev) {
+        ++run;
+        if (run == 62 || last) {
+          out->push_back(kOpRun | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        out->push_back(kOpRun | (run - 1));
+        run = 0;
+      }
+
+      const Uint32 h = Hash(px);
+      if (index[h] == px) {
+        out->push_back(kOpIndex | h);
+      } else {
+        index[h] = px;
+        const Uint8 r = px >> 16, g = px >> 8, b = px;
+        if ((px & 0xff000000) == (prev & 0xff000000)) {
+          const signed char vr = r - (Uint8)(prev >> 16);
+          const signed char vg = g - (Uint8)(prev >> 8);
+          const signed char vb = b - (Uint8)prev;
+          const signed char vg_r = vr - vg;
+          const signed char vg_b = vb - vg;
+          if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+            out->push_back(kOpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+          } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 &&
+                     vg_b > -9 && vg_b < 8) {
+            out->push_back(kOpLuma | (vg + 32));
+            out->push_back((vg_r + 8) << 4 | (vg_b + 8));
+          } else {
+            out->push_back(kOpRgb);
+            out->push_back(r);
+            out->push_back(g);
+            out->push_back(b);
+          }
+        } else {
+          out->push_back(kOpRgba);
+          out->push_back(r);
+          out->push_back(g);
+          out->push_back(b);
+          out->push_back(px >> 24);
+        }
+      }
+      prev = px;
+    }
+  }
+  out->insert(out->end(), kPadding, kPadding + sizeof(kPadding));
+  return true;
+}
+
+}  // namespace carousel
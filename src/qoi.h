@@ -0,0 +1,22 @@
+#ifndef QOI_H
+#define QOI_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+namespace carousel {
+
+/*
+ * Decode a QOI image (https://qoiformat.org) held in memory into a new
+ * ARGB8888 surface.  Returns NULL and sets the SDL error on bad data.
+ */
+SDL_Surface* DecodeQoi(const Uint8* data, size_t size);
+
+/*
+ * Encode an ARGB8888 surface as QOI, replacing the contents of out.
+ */
+bool EncodeQoi(SDL_Surface* surface, std::vector<Uint8>* out);
+
+}  // namespace carousel
+
+#endif
@@ -1,6 +1,8 @@
 #include "res_path.h"
 
 #include <SDL2/SDL.h>
+#include <strings.h>
+
 #include <iostream>
 
 namespace carousel {
@@ -32,4 +34,9 @@ std::string GetResourcePath(const std::string& subDir) {
   return subDir.empty() ? baseRes : baseRes + subDir + PATH_SEP;
 }
 
+bool HasExtension(const std::string& file, const std::string& ext) {
+  return file.size() > ext.size() &&
+         strcasecmp(file.c_str() + file.size() - ext.size(), ext.c_str()) == 0;
+}
+
 }  // namespace carousel
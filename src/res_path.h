@@ -10,6 +10,11 @@ namespace carousel {
  */
 std::string GetResourcePath(const std::string& subDir = "");
 
+/*
+ * Whether file ends in ext, ignoring case.  ext includes the dot.
+ */
+bool HasExtension(const std::string& file, const std::string& ext);
+
 }  // namespace carousel
 
 #endif
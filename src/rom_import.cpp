@@ -0,0 +1,429 @@
+#include "rom_import.h"
+
+#include <SDL2/SDL.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace carousel {
+
+namespace {
+
+// One directory for a ListMain() thread to read.
+struct Listing {
+  const std::string* dir;
+  std::vector<std::string>* entries;
+  // errno if the directory could not be read.
+  int error;
+};
+
+int ListMain(void* data) {
+  Listing* listing = static_cast<Listing*>(data);
+  DIR* dir = opendir(listing->dir->c_str());
+  if (dir == NULL) {
+    listing->error = errno;
+    return 0;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      listing->entries->push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  return 0;
+}
+
+void AppendUtf8(long code, std::string* out) {
+  if (code < 0x80) {
+    out->push_back((char)code);
+  } else if (code < 0x800) {
+    out->push_back((char)(0xc0 | (code >> 6)));
+    out->push_back((char)(0x80 | (code & 0x3f)));
+  } else if (code < 0x10000) {
+    out->push_back((char)(0xe0 | (code >> 12)));
+    out->push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+    out->push_back((char)(0x80 | (code & 0x3f)));
+  } else {
+    out->push_back((char)(0xf0 | (code >> 18)));
+    out->push_back((char)(0x80 | ((code >> 12) & 0x3f)));
+    out->push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+    out->push_back((char)(0x80 | (code & 0x3f)));
+  }
+}
+
+// Replace the predefined and numeric character references in s.  Anything
+// else starting with '&' is left alone.
+void DecodeEntities(std::string* s) {
+  size_t amp = s->find('&');
+  if (amp == std::string::npos) {
+    return;
+  }
+  std::string out(*s, 0, amp);
+  size_t i = amp;
+  while (i < s->size()) {
+    const size_t semi = (*s)[i] == '&' ? s->find(';', i) : std::string::npos;
+    if (semi == std::string::npos || semi - i > 10) {
+      out.push_back((*s)[i++]);
+      continue;
+    }
+    const std::string name(*s, i + 1, semi - i - 1);
+    long code = -1;
+    if (name == "amp") {
+      code = '&';
+    } else if (name == "lt") {
+      code = '<';
+    } else if (name == "gt") {
+      code = '>';
+    } else if (name == "quot") {
+      code = '"';
+    } else if (name == "apos") {
+      code = '\'';
+    } else if (name.size() > 1 && name[0] == '#') {
+      code = name[1] == 'x' ? strtol(name.c_str() + 2, NULL, 16)
+                            : strtol(name.c_str() + 1, NULL, 10);
+      if (code <= 0 || code > 0x10ffff) {
+        code = -1;
+      }
+    }
+    if (code < 0) {
+      out.push_back((*s)[i++]);
+      continue;
+    }
+    AppendUtf8(code, &out);
+    i = semi + 1;
+  }
+  s->swap(out);
+}
+
+// Whether tag opens (or is) element name.
+bool IsElement(const std::string& tag, const char* name) {
+  const size_t len = strlen(name);
+  return tag.compare(0, len, name) == 0 &&
+         (tag.size() == len || strchr(" \t\r\n/", tag[len]) != NULL);
+}
+
+// Value of attribute name of tag, entities decoded.  False if tag has none.
+bool GetAttribute(const std::string& tag, const char* name,
+                  std::string* value) {
+  static const char* const kSpace = " \t\r\n";
+  const size_t len = strlen(name);
+  size_t i = tag.find_first_of(kSpace);
+  while (i != std::string::npos) {
+    i = tag.find_first_not_of(kSpace, i);
+    const size_t eq = i == std::string::npos ? i : tag.find('=', i);
+    if (eq == std::string::npos) {
+      return false;
+    }
+    const size_t name_end = tag.find_last_not_of(kSpace, eq - 1) + 1;
+    const size_t open = tag.find_first_of("\"'", eq + 1);
+    const size_t close =
+        open == std::string::npos ? open : tag.find(tag[open], open + 1);
+    if (close == std::string::npos) {
+      return false;
+    }
+    if (name_end - i == len && tag.compare(i, len, name) == 0) {
+      value->assign(tag, open + 1, close - open - 1);
+      DecodeEntities(value);
+      return true;
+    }
+    i = close + 1;
+  }
+  return false;
+}
+
+bool IsYes(const std::string& tag, const char* name, std::string* scratch) {
+  return GetAttribute(tag, name, scratch) && *scratch == "yes";
+}
+
+// Pulls tags and text out of an XML file a chunk at a time.  Just enough
+// XML for listxml dumps: no namespaces, CDATA or entities beyond the
+// predefined and numeric ones.
+class XmlStream {
+ public:
+  explicit XmlStream(int fd)
+      : fd_(fd), buf_(LISTXML_CHUNK), pos_(0), end_(0), failed_(false) {}
+
+  // The next tag without its angle brackets, "machine name=..." or
+  // "/machine".  Text before it is skipped, and so are comments, processing
+  // instructions and the DOCTYPE.  False at the end of the file or if it
+  // cannot be read.
+  bool NextTag(std::string* tag) {
+    for (;;) {
+      if (!SkipPast('<')) {
+        return false;
+      }
+      const int c = Peek();
+      if (c == '!') {
+        if (!SkipDeclaration()) {
+          return false;
+        }
+      } else if (c == '?') {
+        if (!SkipPast('>')) {
+          return false;
+        }
+      } else {
+        return ReadTag(tag);
+      }
+    }
+  }
+
+  // The text up to the next tag, entities decoded.
+  bool Text(std::string* text) {
+    text->clear();
+    for (;;) {
+      if (pos_ == end_ && !Fill()) {
+        break;
+      }
+      const char* start = &buf_[pos_];
+      const char* lt = (const char*)memchr(start, '<', end_ - pos_);
+      const size_t n = lt != NULL ? lt - start : end_ - pos_;
+      if (text->size() + n > LISTXML_MAX_TAG) {
+        failed_ = true;
+        return false;
+      }
+      text->append(start, n);
+      pos_ += n;
+      if (lt != NULL) {
+        break;
+      }
+    }
+    DecodeEntities(text);
+    return !failed_;
+  }
+
+  // Whether reading stopped early, on a read error or malformed markup.
+  bool failed() const { return failed_; }
+
+ private:
+  // Read the next chunk over the last.  False at the end of the file.
+  bool Fill() {
+    pos_ = 0;
+    end_ = 0;
+    for (;;) {
+      ssize_t got = read(fd_, &buf_[0], buf_.size());
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got < 0) {
+        failed_ = true;
+      }
+      if (got <= 0) {
+        return false;
+      }
+      end_ = got;
+      return true;
+    }
+  }
+
+  int Peek() {
+    if (pos_ == end_ && !Fill()) {
+      return -1;
+    }
+    return (unsigned char)buf_[pos_];
+  }
+
+  int Get() {
+    const int c = Peek();
+    if (c >= 0) {
+      ++pos_;
+    }
+    return c;
+  }
+
+  bool SkipPast(char c) {
+    for (;;) {
+      const char* start = &buf_[pos_];
+      const char* at = (const char*)memchr(start, c, end_ - pos_);
+      if (at != NULL) {
+        pos_ += at - start + 1;
+        return true;
+      }
+      if (!Fill()) {
+        return false;
+      }
+    }
+  }
+
+  bool ReadTag(std::string* tag) {
+    tag->clear();
+    char quote = 0;
+    for (;;) {
+      const int c = Get();
+      if (c < 0 || tag->size() == LISTXML_MAX_TAG) {
+        failed_ = true;
+        return false;
+      }
+      if (quote != 0) {
+        if (c == quote) {
+          quote = 0;
+        }
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '>') {
+        return true;
+      }
+      tag->push_back(c);
+    }
+  }
+
+  // Skip a comment, or a declaration such as the DOCTYPE, whose internal
+  // subset holds markup of its own.  The '!' is next.
+  bool SkipDeclaration() {
+    Get();
+    if (Peek() == '-') {
+      return SkipComment();
+    }
+    int depth = 0;
+    char quote = 0;
+    for (;;) {
+      const int c = Get();
+      if (c < 0) {
+        failed_ = true;
+        return false;
+      }
+      if (quote != 0) {
+        if (c == quote) {
+          quote = 0;
+        }
+      } else if (c == '<' && Peek() == '!') {
+        // Comments in the internal subset may hold anything.
+        Get();
+        if (Peek() == '-' && !SkipComment()) {
+          return false;
+        }
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '[') {
+        ++depth;
+      } else if (c == ']') {
+        --depth;
+      } else if (c == '>' && depth <= 0) {
+        return true;
+      }
+    }
+  }
+
+  // Skip "--" and the rest of a comment.
+  bool SkipComment() {
+    Get();
+    Get();
+    int dashes = 0;
+    for (;;) {
+      const int c = Get();
+      if (c < 0) {
+        failed_ = true;
+        return false;
+      }
+      if (c == '>' && dashes >= 2) {
+        return true;
+      }
+      dashes = c == '-' ? dashes + 1 : 0;
+    }
+  }
+
+  int fd_;
+  std::vector<char> buf_;
+  size_t pos_;
+  size_t end_;
+  bool failed_;
+};
+
+}  // namespace
+
+bool ListDirectories(const std::vector<std::string>& dirs,
+                     std::vector<std::vector<std::string> >* entries) {
+  entries->assign(dirs.size(), std::vector<std::string>());
+  std::vector<Listing> listings(dirs.size());
+  std::vector<SDL_Thread*> threads(dirs.size());
+  for (size_t i = 0; i < dirs.size(); ++i) {
+    listings[i].dir = &dirs[i];
+    listings[i].entries = &(*entries)[i];
+    listings[i].error = 0;
+    threads[i] = SDL_CreateThread(ListMain, "ListDirectory", &listings[i]);
+    if (threads[i] == NULL) {
+      // Read it here instead.
+      ListMain(&listings[i]);
+    }
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < dirs.size(); ++i) {
+    if (threads[i] != NULL) {
+      SDL_WaitThread(threads[i], NULL);
+    }
+    if (listings[i].error != 0) {
+      std::cerr << "Could not read directory " << dirs[i] << ": "
+                << strerror(listings[i].error) << std::endl;
+      (*entries)[i].clear();
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool ReadListXml(const std::string& path, const std::set<std::string>& wanted,
+                 std::map<std::string, MachineInfo>* machines) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open " << path << ": " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  XmlStream xml(fd);
+  std::string tag, value;
+  // Seen the root element's start and end.  A dump cut short ends early.
+  bool listxml = false;
+  bool complete = false;
+  // The wanted machine being read, if any.
+  MachineInfo* machine = NULL;
+  while (xml.NextTag(&tag)) {
+    // Older dumps call machines games.
+    if (IsElement(tag, "machine") || IsElement(tag, "game")) {
+      machine = NULL;
+      if (GetAttribute(tag, "name", &value) && wanted.count(value) != 0) {
+        machine = &(*machines)[value];
+        machine->clone = GetAttribute(tag, "cloneof", &value);
+        machine->runnable = !IsYes(tag, "isbios", &value) &&
+                            !IsYes(tag, "isdevice", &value) &&
+                            !IsYes(tag, "ismechanical", &value) &&
+                            !(GetAttribute(tag, "runnable", &value) &&
+                              value == "no");
+        if (tag[tag.size() - 1] == '/') {
+          machine = NULL;
+        }
+      }
+    } else if (tag == "/machine" || tag == "/game") {
+      machine = NULL;
+    } else if (machine != NULL && tag == "description") {
+      xml.Text(&machine->description);
+    } else if (IsElement(tag, "mame") || IsElement(tag, "datafile")) {
+      listxml = true;
+    } else if (tag == "/mame" || tag == "/datafile") {
+      complete = true;
+    }
+  }
+  close(fd);
+
+  if (xml.failed()) {
+    std::cerr << "Could not read " << path << std::endl;
+    return false;
+  }
+  if (!listxml || !complete) {
+    std::cerr << path << " is not a complete MAME -listxml dump"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace carousel
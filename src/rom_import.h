@@ -0,0 +1,55 @@
+#ifndef ROM_IMPORT_H
+#define ROM_IMPORT_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace carousel {
+
+// Bytes of a listxml dump read at a time.  This, the tag being read and the
+// machines asked for are all that is held in memory.
+#define LISTXML_CHUNK (256 * 1024)
+// Longest tag accepted.  listxml tags are well under this.
+#define LISTXML_MAX_TAG (64 * 1024)
+
+// One entry of the imports list in carousel.cfg.
+struct RomImport {
+  std::string dir;
+  std::string emu;
+  std::string genre;
+  // Only files ending in this are imported, every entry if empty.
+  std::string extension;
+  // Import machines listxml says are clones of another.
+  bool clones;
+};
+
+// What a MAME -listxml dump says about one machine.
+struct MachineInfo {
+  MachineInfo() : clone(false), runnable(true) {}
+
+  // Full name, "Ms. Pac-Man".
+  std::string description;
+  // Has a parent set (cloneof).
+  bool clone;
+  // False for BIOS sets, devices and anything else that cannot be started
+  // on its own.
+  bool runnable;
+};
+
+// Names of the entries of each of dirs, except hidden ones, in no particular
+// order.  The directories are read at the same time, a thread each.  Returns
+// false, after reporting it, if any could not be read; its list is empty.
+bool ListDirectories(const std::vector<std::string>& dirs,
+                     std::vector<std::vector<std::string> >* entries);
+
+// Read the listxml dump at path a chunk at a time, keeping what it says about
+// the machines named in wanted.  Returns false, after reporting it, if the
+// file cannot be read or is not a listxml dump.
+bool ReadListXml(const std::string& path, const std::set<std::string>& wanted,
+                 std::map<std::string, MachineInfo>* machines);
+
+}  // namespace carousel
+
+#endif
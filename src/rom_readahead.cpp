@@ -0,0 +1,275 @@
+#include "rom_readahead.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace carousel {
+
+namespace {
+
+// From linux/ioprio.h, which not every libc ships.
+const int kIoprioWhoProcess = 1;
+const int kIoprioClassIdle = 3;
+const int kIoprioClassShift = 13;
+
+void AddFile(const std::string& path, std::vector<std::string>* files) {
+  if (std::find(files->begin(), files->end(), path) == files->end()) {
+    files->push_back(path);
+  }
+}
+
+// path if it is a file, or the files directly in it if it is a directory.
+void AddPath(const std::string& path, std::vector<std::string>* files) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return;
+  }
+  if (S_ISREG(st.st_mode)) {
+    AddFile(path, files);
+    return;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    return;
+  }
+  DIR* dir = opendir(path.c_str());
+  if (dir == NULL) {
+    return;
+  }
+  std::vector<std::string> entries;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      entries.push_back(path + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (stat(entries[i].c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      AddFile(entries[i], files);
+    }
+  }
+}
+
+// cmd split on white space, quotes dropped.  Good enough for the command
+// patterns in carousel.cfg; the shell still runs the real thing.
+void SplitCommand(const std::string& cmd, std::vector<std::string>* args) {
+  args->clear();
+  std::string arg;
+  bool in_arg = false;
+  for (size_t i = 0; i <= cmd.size(); ++i) {
+    const char c = i < cmd.size() ? cmd[i] : ' ';
+    if (c == ' ' || c == '\t') {
+      if (in_arg) {
+        args->push_back(arg);
+        arg.clear();
+        in_arg = false;
+      }
+    } else {
+      if (c != '"' && c != '\'') {
+        arg.push_back(c);
+      }
+      in_arg = true;
+    }
+  }
+}
+
+}  // namespace
+
+void FindRomFiles(const std::string& cmd, const std::string& rom,
+                  std::vector<std::string>* files) {
+  files->clear();
+  std::vector<std::string> args;
+  SplitCommand(cmd, &args);
+  for (size_t i = 0; i < args.size(); ++i) {
+    const size_t pattern = args[i].find("%s");
+    if (pattern != std::string::npos) {
+      std::string path(args[i]);
+      path.replace(pattern, 2, rom);
+      AddPath(path, files);
+    }
+    if ((args[i] == "-rompath" || args[i] == "-rp") && i + 1 < args.size()) {
+      const std::string& dirs = args[i + 1];
+      size_t begin = 0;
+      while (begin <= dirs.size()) {
+        size_t end = dirs.find(';', begin);
+        if (end == std::string::npos) {
+          end = dirs.size();
+        }
+        if (end > begin) {
+          const std::string base = dirs.substr(begin, end - begin) + "/" + rom;
+          AddPath(base, files);
+          AddPath(base + ".zip", files);
+          AddPath(base + ".7z", files);
+        }
+        begin = end + 1;
+      }
+    }
+  }
+}
+
+RomReadahead::RomReadahead()
+    : thread_(NULL),
+      lock_(NULL),
+      wake_(NULL),
+      stopping_(false),
+      generation_(0),
+      requested_(false),
+      limit_(0) {}
+
+RomReadahead::~RomReadahead() { Stop(); }
+
+bool RomReadahead::Start() {
+  if (thread_ != NULL) {
+    return true;
+  }
+  lock_ = SDL_CreateMutex();
+  wake_ = SDL_CreateCond();
+  if (lock_ == NULL || wake_ == NULL) {
+    std::cerr << "Could not create readahead lock: " << SDL_GetError()
+              << std::endl;
+    Stop();
+    return false;
+  }
+  stopping_ = false;
+  thread_ = SDL_CreateThread(ReadMain, "RomReadahead", this);
+  if (thread_ == NULL) {
+    std::cerr << "Could not start readahead thread: " << SDL_GetError()
+              << std::endl;
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+void RomReadahead::Stop() {
+  if (lock_ != NULL) {
+    SDL_LockMutex(lock_);
+    stopping_ = true;
+    generation_++;
+    SDL_CondBroadcast(wake_);
+    SDL_UnlockMutex(lock_);
+  }
+  if (thread_ != NULL) {
+    SDL_WaitThread(thread_, NULL);
+    thread_ = NULL;
+  }
+  if (wake_ != NULL) {
+    SDL_DestroyCond(wake_);
+    wake_ = NULL;
+  }
+  if (lock_ != NULL) {
+    SDL_DestroyMutex(lock_);
+    lock_ = NULL;
+  }
+}
+
+void RomReadahead::Request(const std::string& cmd, const std::string& rom,
+                           Uint64 limit) {
+  if (thread_ == NULL) {
+    return;
+  }
+  SDL_LockMutex(lock_);
+  generation_++;
+  requested_ = true;
+  cmd_ = cmd;
+  rom_ = rom;
+  limit_ = limit;
+  SDL_CondSignal(wake_);
+  SDL_UnlockMutex(lock_);
+}
+
+void RomReadahead::Cancel() {
+  if (thread_ == NULL) {
+    return;
+  }
+  SDL_LockMutex(lock_);
+  generation_++;
+  requested_ = false;
+  SDL_UnlockMutex(lock_);
+}
+
+int RomReadahead::ReadMain(void* data) {
+  static_cast<RomReadahead*>(data)->Run();
+  return 0;
+}
+
+bool RomReadahead::Current(Uint32 generation) {
+  SDL_LockMutex(lock_);
+  const bool current = generation == generation_;
+  SDL_UnlockMutex(lock_);
+  return current;
+}
+
+void RomReadahead::Run() {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+  // Idle class: any other read, the emulator's included, goes first.
+  syscall(SYS_ioprio_set, kIoprioWhoProcess, 0,
+          kIoprioClassIdle << kIoprioClassShift);
+#endif
+  SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+  std::vector<char> buf(READAHEAD_CHUNK);
+  std::vector<std::string> files;
+
+  SDL_LockMutex(lock_);
+  for (;;) {
+    while (!stopping_ && !requested_) {
+      SDL_CondWait(wake_, lock_);
+    }
+    if (stopping_) {
+      break;
+    }
+    requested_ = false;
+    const Uint32 generation = generation_;
+    const std::string cmd = cmd_;
+    const std::string rom = rom_;
+    Uint64 limit = limit_;
+    SDL_UnlockMutex(lock_);
+
+    FindRomFiles(cmd, rom, &files);
+    for (size_t i = 0; i < files.size() && limit > 0; ++i) {
+      ReadFile(files[i], generation, &limit, &buf[0]);
+    }
+
+    SDL_LockMutex(lock_);
+  }
+  SDL_UnlockMutex(lock_);
+}
+
+void RomReadahead::ReadFile(const std::string& file, Uint32 generation,
+                            Uint64* limit, char* buf) {
+  int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  // Read rather than posix_fadvise(POSIX_FADV_WILLNEED), which queues the
+  // whole file at once with no way to take it back when the player moves
+  // on.  What has been read stays cached for the emulator.
+  while (*limit > 0 && Current(generation)) {
+    const size_t want = (size_t)std::min<Uint64>(*limit, READAHEAD_CHUNK);
+    const ssize_t got = read(fd, buf, want);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      break;
+    }
+    *limit -= got;
+  }
+  close(fd);
+}
+
+}  // namespace carousel
@@ -0,0 +1,61 @@
+#ifndef ROM_READAHEAD_H
+#define ROM_READAHEAD_H
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+namespace carousel {
+
+// Bytes read between checks for a cancel.  An SD card reads this in a few
+// tens of ms.
+#define READAHEAD_CHUNK (1024 * 1024)
+
+// The files an emulator started with cmd (a command pattern whose %s is
+// replaced with rom) will likely read: any argument the rom goes into that
+// names a file, or the files of a directory it names, and the rom found
+// along a MAME style -rompath as a file, .zip, .7z or a directory of CHDs.
+void FindRomFiles(const std::string& cmd, const std::string& rom,
+                  std::vector<std::string>* files);
+
+// Reads the ROM files of the card the player has stopped on into the page
+// cache, so the emulator finds them there.  One thread at idle I/O priority
+// reads a chunk at a time and drops the work as soon as it is cancelled.
+class RomReadahead {
+ public:
+  RomReadahead();
+  ~RomReadahead();
+
+  bool Start();
+  // Cancel and wait for the thread to finish its chunk.
+  void Stop();
+
+  // Read the files of cmd and rom, see FindRomFiles(), up to limit bytes in
+  // all, instead of whatever was being read.
+  void Request(const std::string& cmd, const std::string& rom, Uint64 limit);
+  void Cancel();
+
+ private:
+  static int ReadMain(void* data);
+  void Run();
+  // Read file until limit bytes have been read in all or the request is no
+  // longer generation.
+  void ReadFile(const std::string& file, Uint32 generation, Uint64* limit,
+                char* buf);
+  bool Current(Uint32 generation);
+
+  SDL_Thread* thread_;
+  SDL_mutex* lock_;
+  SDL_cond* wake_;
+  bool stopping_;
+  // Bumped by every Request() and Cancel().
+  Uint32 generation_;
+  bool requested_;
+  std::string cmd_;
+  std::string rom_;
+  Uint64 limit_;
+};
+
+}  // namespace carousel
+
+#endif
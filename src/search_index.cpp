@@ -0,0 +1,120 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "carousel.h"
+
+namespace carousel {
+
+SearchIndex::SearchIndex() {
+  for (int b = 0; b <= 256; ++b) {
+    first_[b] = 0;
+  }
+}
+
+std::string SearchIndex::Normalize(const std::string& s) {
+  std::string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c >= 'A' && c <= 'Z') {
+      out.push_back(c - 'A' + 'a');
+    } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+               c >= 0x80) {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+void SearchIndex::Build(const Carousel& carousel, int genre) {
+  const Genre& g = carousel.genres[genre];
+  const CardStore& cards = carousel.cards;
+
+  std::vector<std::pair<std::string, int> > named;
+  named.reserve(g.count);
+  for (int i = 0; i < g.count; ++i) {
+    const int card = g.first + i;
+    std::string name;
+    if (cards.title[card] >= 0) {
+      name = carousel.titles.Get(cards.title[card]);
+    } else if (cards.rom[card] >= 0) {
+      name = carousel.roms.Get(cards.rom[card]);
+      size_t dot = name.rfind('.');
+      if (dot != std::string::npos && dot > 0) {
+        name.erase(dot);
+      }
+    } else if (cards.genre[card] >= 0) {
+      name = carousel.genre_names.Get(cards.genre[card]);
+    }
+    name = Normalize(name);
+    // Back cards have no name.
+    if (!name.empty()) {
+      named.push_back(std::make_pair(name, i));
+    }
+  }
+  // Padding repeats come after the cards they copy, so ties go to the
+  // original.
+  std::sort(named.begin(), named.end());
+
+  names_.resize(named.size());
+  cards_.resize(named.size());
+  rank_.assign(g.count, -1);
+  for (size_t i = 0; i < named.size(); ++i) {
+    names_[i].swap(named[i].first);
+    cards_[i] = named[i].second;
+    rank_[cards_[i]] = i;
+  }
+
+  size_t pos = 0;
+  for (int b = 0; b <= 256; ++b) {
+    while (pos < names_.size() && (unsigned char)names_[pos][0] < b) {
+      ++pos;
+    }
+    first_[b] = pos;
+  }
+}
+
+int SearchIndex::Find(const std::string& prefix) const {
+  if (prefix.empty()) {
+    return -1;
+  }
+  const unsigned char c = prefix[0];
+  // Only names with the same first byte can match.
+  const std::vector<std::string>::const_iterator begin =
+      names_.begin() + first_[c];
+  const std::vector<std::string>::const_iterator end =
+      names_.begin() + first_[c + 1];
+  std::vector<std::string>::const_iterator it =
+      std::lower_bound(begin, end, prefix);
+  if (it == end || it->compare(0, prefix.size(), prefix) != 0) {
+    return -1;
+  }
+  return cards_[it - names_.begin()];
+}
+
+int SearchIndex::NextGroup(int index, int step) const {
+  const int n = names_.size();
+  if (n == 0) {
+    return -1;
+  }
+  const int rank = rank_[index];
+  int pos;
+  if (rank < 0) {
+    // From a card without a name, the first or last group.
+    pos = step > 0 ? 0 : first_[(unsigned char)names_[n - 1][0]];
+  } else if (step > 0) {
+    pos = first_[(unsigned char)names_[rank][0] + 1];
+    if (pos == n) {
+      pos = 0;
+    }
+  } else {
+    pos = first_[(unsigned char)names_[rank][0]];
+    pos = pos == 0 ? n - 1 : pos - 1;
+    pos = first_[(unsigned char)names_[pos][0]];
+  }
+  return cards_[pos];
+}
+
+}  // namespace carousel
@@ -0,0 +1,47 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <string>
+#include <vector>
+
+namespace carousel {
+
+class Carousel;
+
+// Finds the cards of one genre by name.  A card's name is its title, or
+// else its ROM file name without the extension, or for a genre card the
+// genre's name.  Names are compared in lower case with everything but
+// letters and digits left out, so "mspacman" finds "Ms. Pac-Man".
+//
+// Names are kept sorted, with the position of the first name starting with
+// each byte, so a search only bisects the names sharing its first letter.
+class SearchIndex {
+ public:
+  SearchIndex();
+
+  void Build(const Carousel& carousel, int genre);
+
+  // Index in the genre of the first card, in name order, whose name starts
+  // with prefix.  -1 if there is none.
+  int Find(const std::string& prefix) const;
+  // Index of the first card of the next (step 1) or previous (step -1)
+  // group of names starting with the same letter, counting from the group
+  // of card index.  Wraps around.  -1 if no card has a name.
+  int NextGroup(int index, int step) const;
+
+  // s as names are compared.
+  static std::string Normalize(const std::string& s);
+
+ private:
+  // Sorted names, and the index in the genre of each.
+  std::vector<std::string> names_;
+  std::vector<int> cards_;
+  // Position in names_ of each card of the genre, -1 for cards without one.
+  std::vector<int> rank_;
+  // Position in names_ of the first name whose first byte is at least b.
+  int first_[257];
+};
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,167 @@
+#include "stats.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace carousel {
+
+Histogram::Histogram() : count_(0), max_(0), total_(0) {
+  for (int i = 0; i < kBuckets; ++i) {
+    buckets_[i] = 0;
+  }
+}
+
+int Histogram::Bucket(Uint64 micros) {
+  const Uint64 sub = 1 << kSubBits;
+  if (micros < sub) {
+    return micros;
+  }
+  int exponent = kSubBits;
+  while ((micros >> exponent) > 1) {
+    ++exponent;
+  }
+  const int bucket = (exponent - kSubBits + 1) * sub +
+                     ((micros >> (exponent - kSubBits)) & (sub - 1));
+  return std::min(bucket, kBuckets - 1);
+}
+
+Uint64 Histogram::BucketLow(int bucket) {
+  const int sub = 1 << kSubBits;
+  if (bucket < sub) {
+    return bucket;
+  }
+  const int shift = bucket / sub - 1;
+  return (Uint64)(sub + bucket % sub) << shift;
+}
+
+void Histogram::Record(Uint64 micros) {
+  buckets_[Bucket(micros)]++;
+  count_++;
+  total_ += micros;
+  if (micros > max_) {
+    max_ = micros;
+  }
+}
+
+Uint64 Histogram::Percentile(double p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // Rank of the wanted value, counting from 1.
+  Uint64 rank = (Uint64)(p / 100 * count_ + 0.5);
+  rank = std::max<Uint64>(1, std::min(rank, count_));
+  Uint64 seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return i + 1 < kBuckets ? std::min(BucketLow(i + 1) - 1, max_) : max_;
+    }
+  }
+  return max_;
+}
+
+Stats::Stats()
+    : spin_steps(0),
+      jumps(0),
+      textures_loaded(0),
+      launches(0),
+      start_ticks(SDL_GetTicks()) {}
+
+static void WriteHistogram(std::ostream& out, const char* name,
+                           const Histogram& histogram) {
+  out << name << "_count " << histogram.count() << "\n"
+      << name << "_p50_us " << histogram.Percentile(50) << "\n"
+      << name << "_p95_us " << histogram.Percentile(95) << "\n"
+      << name << "_p99_us " << histogram.Percentile(99) << "\n"
+      << name << "_max_us " << histogram.max() << "\n";
+}
+
+void Stats::Write(std::ostream& out) const {
+  out << "uptime_s " << (SDL_GetTicks() - start_ticks) / 1000 << "\n";
+  WriteHistogram(out, "frame_time", frame_time);
+  WriteHistogram(out, "input_latency", input_latency);
+  out << "spin_steps " << spin_steps << "\n"
+      << "jumps " << jumps << "\n"
+      << "textures_loaded " << textures_loaded << "\n"
+      << "load_time_total_us " << load_time.total() << "\n";
+  WriteHistogram(out, "load_time", load_time);
+  out << "launches " << launches << "\n";
+  WriteHistogram(out, "return_time", return_time);
+}
+
+void Stats::Dump(const std::string& path) const {
+  // Written whole and renamed so a collector never reads half a file.
+  std::string tmp_path = path + ".tmp";
+  std::ofstream file(tmp_path.c_str(),
+                     std::ofstream::out | std::ofstream::trunc);
+  Write(file);
+  file.close();
+  if (file.fail() || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::cerr << "Could not write stats to " << path << std::endl;
+    remove(tmp_path.c_str());
+  }
+}
+
+void BlockDumpSignal() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+}
+
+namespace {
+
+struct DumpSignalTarget {
+  Uint32 event_type;
+  int wake_fd;
+};
+
+int DumpSignalMain(void* data) {
+  const DumpSignalTarget target = *static_cast<DumpSignalTarget*>(data);
+  delete static_cast<DumpSignalTarget*>(data);
+
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  for (;;) {
+    int signal;
+    if (sigwait(&signals, &signal) != 0) {
+      return 1;
+    }
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = target.event_type;
+    SDL_PushEvent(&event);
+    if (target.wake_fd >= 0) {
+      // A full pipe wakes the reader all the same.
+      ssize_t written = write(target.wake_fd, "", 1);
+      (void)written;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+bool StartDumpSignalThread(Uint32 event_type, int wake_fd) {
+  DumpSignalTarget* data = new DumpSignalTarget;
+  data->event_type = event_type;
+  data->wake_fd = wake_fd;
+  SDL_Thread* thread = SDL_CreateThread(DumpSignalMain, "StatsSignal", data);
+  if (thread == NULL) {
+    std::cerr << "Could not start stats signal thread: " << SDL_GetError()
+              << std::endl;
+    delete data;
+    return false;
+  }
+  // Lives until the process exits.
+  SDL_DetachThread(thread);
+  return true;
+}
+
+}  // namespace carousel
@@ -0,0 +1,80 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <SDL2/SDL.h>
+#include <ostream>
+#include <string>
+
+namespace carousel {
+
+// Distribution of durations in microseconds.  Buckets are an eighth of a
+// power of two wide, so percentiles are within 12.5% and recording a value
+// is a few instructions.
+class Histogram {
+ public:
+  Histogram();
+
+  void Record(Uint64 micros);
+  // Upper bound of the bucket holding the p-th percentile, 0 <= p <= 100.
+  Uint64 Percentile(double p) const;
+
+  Uint64 count() const { return count_; }
+  Uint64 max() const { return max_; }
+  Uint64 total() const { return total_; }
+
+ private:
+  // Enough for about 35 minutes.
+  enum { kSubBits = 3, kBuckets = 240 };
+
+  static int Bucket(Uint64 micros);
+  static Uint64 BucketLow(int bucket);
+
+  Uint64 buckets_[kBuckets];
+  Uint64 count_;
+  Uint64 max_;
+  Uint64 total_;
+};
+
+// Always on counters for the render loop.  Updating them is cheap; they are
+// only formatted when dumped.
+struct Stats {
+  Stats();
+
+  // Time from one presented frame to the next, while drawing every frame.
+  Histogram frame_time;
+  // Time from an input event to the first present after it.
+  Histogram input_latency;
+  // Cards the carousel spun past.
+  Uint64 spin_steps;
+  // Searches and letter jumps that moved the selection.
+  Uint64 jumps;
+  // Card images uploaded to the renderer.
+  Uint64 textures_loaded;
+  // Time spent uploading card images, see PumpImages().
+  Histogram load_time;
+  // Games run in resident mode.
+  Uint64 launches;
+  // Time from a game exiting to the menu being ready to draw again.
+  Histogram return_time;
+  Uint32 start_ticks;
+
+  void Write(std::ostream& out) const;
+  // Replace path with the current numbers.  Failures are logged.
+  void Dump(const std::string& path) const;
+};
+
+/*
+ * Hold SIGUSR1 for sigwait().  Call before any other thread is started so
+ * they all inherit the mask.
+ */
+void BlockDumpSignal();
+
+/*
+ * Start a thread that pushes an SDL event of type event_type every time the
+ * process gets SIGUSR1, then writes a byte to wake_fd unless it is -1.
+ */
+bool StartDumpSignalThread(Uint32 event_type, int wake_fd);
+
+}  // namespace carousel
+
+#endif
@@ -0,0 +1,37 @@
+#include "string_table.h"
+
+namespace carousel {
+
+int StringTable::Intern(const std::string& s) {
+  std::pair<std::map<std::string, int>::iterator, bool> added =
+      ids_.insert(std::make_pair(s, (int)strings_.size()));
+  if (added.second) {
+    strings_.push_back(&added.first->first);
+  }
+  return added.first->second;
+}
+
+int StringTable::Find(const std::string& s) const {
+  std::map<std::string, int>::const_iterator it = ids_.find(s);
+  return it == ids_.end() ? -1 : it->second;
+}
+
+void StringTable::Clear() {
+  ids_.clear();
+  strings_.clear();
+}
+
+void StringTable::Assign(const StringTable& other) {
+  Clear();
+  for (int i = 0; i < other.size(); ++i) {
+    Intern(other.Get(i));
+  }
+}
+
+void StringTable::Swap(StringTable& other) {
+  // Map nodes move with the swap, so the pointers stay good.
+  ids_.swap(other.ids_);
+  strings_.swap(other.strings_);
+}
+
+}  // namespace carousel
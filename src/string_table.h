@@ -0,0 +1,41 @@
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace carousel {
+
+// Gives each distinct string a small integer id, counting up from 0 in the
+// order they are first seen, so everything after parsing compares and
+// indexes by id.  Each string is stored once.
+class StringTable {
+ public:
+  StringTable() {}
+
+  // Id of s, adding it if it is new.
+  int Intern(const std::string& s);
+  // Id of s, or -1 if it was never interned.
+  int Find(const std::string& s) const;
+  const std::string& Get(int id) const { return *strings_[id]; }
+  int size() const { return strings_.size(); }
+
+  void Clear();
+  void Swap(StringTable& other);
+  // Make this a copy of other, with the same ids.
+  void Assign(const StringTable& other);
+
+ private:
+  // strings_ points into ids_, so copies would dangle.
+  StringTable(const StringTable&);
+  StringTable& operator=(const StringTable&);
+
+  std::map<std::string, int> ids_;
+  // Keys of ids_, by id.
+  std::vector<const std::string*> strings_;
+};
+
+}  // namespace carousel
+
+#endif
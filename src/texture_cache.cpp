@@ -0,0 +1,169 @@
+#include "texture_cache.h"
+
+#include <iostream>
+
+namespace carousel {
+
+TextureCache::TextureCache()
+    : card_w_(0),
+      card_h_(0),
+      budget_setting_(0),
+      budget_(0),
+      over_budget_logged_(false),
+      newest_(-1),
+      oldest_(-1) {}
+
+void TextureCache::SetCardSize(int card_w, int card_h) {
+  if (card_w == card_w_ && card_h == card_h_) {
+    return;
+  }
+  Clear();
+  card_w_ = card_w;
+  card_h_ = card_h;
+  int chain_w, chain_h;
+  MipChainSize(card_w, card_h, &chain_w, &chain_h);
+  atlas_.SetCellSize(chain_w, chain_h);
+  UpdateBudget();
+}
+
+void TextureCache::SetBudget(size_t bytes) {
+  budget_setting_ = bytes;
+  UpdateBudget();
+}
+
+void TextureCache::UpdateBudget() {
+  budget_ = budget_setting_;
+  if (budget_ == 0 && card_w_ > 0) {
+    budget_ = atlas_.BytesFor(TEXTURE_BUDGET_CARDS);
+  }
+}
+
+void TextureCache::Reserve(int num_images) {
+  if (num_images > (int)entries_.size()) {
+    entries_.resize(num_images);
+  }
+}
+
+TextureCache::Entry& TextureCache::At(int id) {
+  Reserve(id + 1);
+  return entries_[id];
+}
+
+void TextureCache::Link(int id) {
+  Entry& entry = entries_[id];
+  entry.newer = -1;
+  entry.older = newest_;
+  if (newest_ >= 0) {
+    entries_[newest_].newer = id;
+  } else {
+    oldest_ = id;
+  }
+  newest_ = id;
+}
+
+void TextureCache::Unlink(int id) {
+  Entry& entry = entries_[id];
+  if (entry.newer >= 0) {
+    entries_[entry.newer].older = entry.older;
+  } else {
+    newest_ = entry.older;
+  }
+  if (entry.older >= 0) {
+    entries_[entry.older].newer = entry.newer;
+  } else {
+    oldest_ = entry.newer;
+  }
+  entry.newer = -1;
+  entry.older = -1;
+}
+
+bool TextureCache::Add(SDL_Renderer* ren, int id, const void* pixels,
+                       int pitch) {
+  if (Contains(id)) {
+    return true;
+  }
+  MakeRoom();
+
+  Entry& entry = At(id);
+  SDL_Rect chain;
+  if (!atlas_.Add(ren, pixels, pitch, &entry.image.texture, &chain)) {
+    std::cerr << "Could not add image to atlas" << std::endl;
+    return false;
+  }
+  MipLayout(card_w_, card_h_, entry.image.level);
+  for (int i = 0; i < MIP_LEVELS; ++i) {
+    entry.image.level[i].x += chain.x;
+    entry.image.level[i].y += chain.y;
+  }
+  Link(id);
+  entry.resident = true;
+  return true;
+}
+
+void TextureCache::Remove(int id) {
+  if (!Contains(id)) {
+    return;
+  }
+  Entry& entry = entries_[id];
+  atlas_.Remove(entry.image.texture, entry.image.level[0]);
+  entry.resident = false;
+  Unlink(id);
+}
+
+void TextureCache::Pin(int id) { At(id).pins++; }
+
+void TextureCache::Unpin(int id) {
+  if (id < (int)entries_.size() && entries_[id].pins > 0) {
+    entries_[id].pins--;
+  }
+}
+
+void TextureCache::Clear() {
+  atlas_.Clear();
+  // Pins outlive the images.
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    entries_[i].resident = false;
+  }
+  newest_ = -1;
+  oldest_ = -1;
+}
+
+void TextureCache::Trim(size_t bytes) { Evict(bytes, false); }
+
+void TextureCache::Evict(size_t bytes, bool room) {
+  int evicted = 0;
+  int id = oldest_;
+  while (atlas_.bytes() + (room ? atlas_.AddBytes() : 0) > bytes && id >= 0) {
+    Entry& entry = entries_[id];
+    const int newer = entry.newer;
+    if (entry.pins == 0) {
+      atlas_.Remove(entry.image.texture, entry.image.level[0]);
+      entry.resident = false;
+      Unlink(id);
+      evicted++;
+    }
+    id = newer;
+  }
+  if (evicted > 0) {
+    std::cerr << "Evicted " << evicted << " images from texture cache, "
+              << atlas_.bytes() / 1024 << "/" << budget_ / 1024 << " KB used"
+              << std::endl;
+  }
+}
+
+void TextureCache::MakeRoom() {
+  Evict(budget_, true);
+
+  if (atlas_.bytes() + atlas_.AddBytes() > budget_) {
+    if (!over_budget_logged_) {
+      std::cerr << "Texture cache over budget with " << atlas_.bytes() / 1024
+                << " KB of pages pinned, budget is " << budget_ / 1024
+                << " KB" << std::endl;
+      over_budget_logged_ = true;
+    }
+  } else {
+    over_budget_logged_ = false;
+  }
+}
+
+}  // namespace carousel
@@ -0,0 +1,113 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+#include "atlas.h"
+
+namespace carousel {
+
+// Cards a texture_budget of 0 makes room for: a few genres' worth.
+#define TEXTURE_BUDGET_CARDS 64
+
+// Card images of every genre visited so far, packed into one atlas.  Images
+// stay resident after their genre is left and are only evicted, least
+// recently used first, once the atlas pages would exceed the byte budget.
+// Memory is only given back a page at a time, so it is the pages that
+// count, not the images in them; a new image fills a cell freed by an
+// eviction before it takes another page.  Pinned images (the
+// ones the current screen needs) are never evicted.  Images are known by
+// their id in Carousel::image_names, which indexes the cache directly.
+class TextureCache {
+ public:
+  TextureCache();
+
+  // 0 sizes the budget for TEXTURE_BUDGET_CARDS cards of the card size.
+  void SetBudget(size_t bytes);
+  // Size of the cards held.  Clears the cache if it changes.
+  void SetCardSize(int card_w, int card_h);
+
+  // Make room for ids up to num_images - 1 up front, so the render loop
+  // never grows the cache.  Larger ids still work.
+  void Reserve(int num_images);
+
+  // Image id, or NULL if it is not resident.  Counts as a use.
+  const CardImage* Find(int id) {
+    if (id >= (int)entries_.size() || !entries_[id].resident) {
+      return NULL;
+    }
+    if (id != newest_) {
+      Unlink(id);
+      Link(id);
+    }
+    return &entries_[id].image;
+  }
+  bool Contains(int id) const {
+    return id < (int)entries_.size() && entries_[id].resident;
+  }
+  // Upload a card's mip chain, evicting older images to make room.
+  bool Add(SDL_Renderer* ren, int id, const void* pixels, int pitch);
+  // Drop image id, pinned or not, because its file changed.
+  void Remove(int id);
+
+  // Pins are counted; an image is evictable again once every Pin() has been
+  // matched by an Unpin().  Images may be pinned before they are resident.
+  void Pin(int id);
+  void Unpin(int id);
+  bool Pinned(int id) const {
+    return id < (int)entries_.size() && entries_[id].pins > 0;
+  }
+
+  // Evict unpinned images, least recently used first, until the atlas pages
+  // take at most bytes.
+  void Trim(size_t bytes);
+  void Clear();
+
+  size_t bytes() const { return atlas_.bytes(); }
+  size_t budget() const { return budget_; }
+
+ private:
+  struct Entry {
+    Entry() : resident(false), pins(0), newer(-1), older(-1) {}
+
+    CardImage image;
+    bool resident;
+    int pins;
+    // Neighbours in the use order while resident, -1 at either end.  Kept
+    // in the entry so that using or adding an image never allocates.
+    int newer;
+    int older;
+  };
+
+  // Entry for id, growing entries_ if needed.
+  Entry& At(int id);
+  // Put resident id first in the use order, or take it out.
+  void Link(int id);
+  void Unlink(int id);
+
+  // Evict unpinned images, least recently used first, until the pages take
+  // at most bytes, counting the page the next Add() needs if room is set.
+  void Evict(size_t bytes, bool room);
+  // Evict unpinned images until the next Add() fits in the budget.
+  void MakeRoom();
+  // budget_ from budget_setting_ and the card size.
+  void UpdateBudget();
+
+  TextureAtlas atlas_;
+  int card_w_;
+  int card_h_;
+  // As given to SetBudget().
+  size_t budget_setting_;
+  size_t budget_;
+  bool over_budget_logged_;
+  // By image id.
+  std::vector<Entry> entries_;
+  // Ends of the use order of resident ids, -1 if there are none.
+  int newest_;
+  int oldest_;
+};
+
+}  // namespace carousel
+
+#endif